@@ -16,6 +16,9 @@
 // new () T() should be global
 #include <memory>
 #include "ECS/Base/Constants.hpp"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #if defined(__GNUC__) || defined(__clang__)
 #define PACK(x) x __attribute__((__packed__))
@@ -49,6 +52,33 @@ inline uint32_t alignCacheLineSize(uint32_t size){
 inline uint32_t alignPointerSize(uint32_t size){
     return (size+((uint32_t)sizeof(void*)-1))&(~((uint32_t)sizeof(void*)-1));
 }
+/// @brief index of the lowest set bit
+/// @warning undefined for zero
+inline uint32_t countTrailingZeros(uint64_t value){
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctzll(value);
+#endif
+}
+/// @brief number of set bits
+inline uint32_t countSetBits(uint32_t value){
+#if defined(_MSC_VER) && !defined(__clang__)
+    return (uint32_t)__popcnt(value);
+#else
+    return (uint32_t)__builtin_popcount(value);
+#endif
+}
+/// @brief hints the CPU to load the cache line holding address, never faults
+inline void prefetch(const void *address){
+#if defined(_MSC_VER) && !defined(__clang__)
+    _mm_prefetch((const char*)address, _MM_HINT_T0);
+#else
+    __builtin_prefetch(address, 0, 3);
+#endif
+}
 void* _allocate(size_t);
 void _deallocate(void*);
 extern ssize_t allocator_counter;
@@ -73,7 +73,7 @@ public:
     inline void possiblyGrow() { if (unoccupiedNodes() < capacity / 3) resize(capacity * 2); }
     inline void possiblyShrink() { if (occupiedNodes() < capacity / 3) resize(capacity / 2); }
     void appendFrom(const set& src){
-        for (uint32_t offset = 0; offset < capacity; ++offset)
+        for (uint32_t offset = 0; offset < src.capacity; ++offset)
         {
             Hash32 hash = src.hashes[offset];
             if (hash != _InvalidHashCode && hash != _SkipCode)
@@ -3,9 +3,10 @@
 
 #include <stdint.h>
 #include <vector>
-#include <bitset>
 #include "cutil/basics.hpp"
 #include "Base/TypeID.hpp"
+#include "Base/AoSoA.hpp"
+#include "CopyKernels.hpp"
 #include "ArchetypeChunkData.hpp"
 #include "ChunkListMap.hpp"
 #include "Base/Constants.hpp"
@@ -28,9 +29,28 @@ namespace ECS
     inline ArchetypeFlags & operator&=(ArchetypeFlags & x, ArchetypeFlags y){ x = x & y;return x; }
     inline ArchetypeFlags & operator|=(ArchetypeFlags & x, ArchetypeFlags y) { x = x | y;return x; }
     struct EntityComponentStore;
+    struct ComponentColumn;
     struct ChunkListChanges;
     struct Chunk;
     struct EntityQueryData;
+    struct Archetype;
+    /// @brief cached result of adding or removing a single type to an archetype
+    struct ArchetypeEdge {
+        TypeID type;
+        /// @brief destination, nullptr if the transition does not change the archetype
+        Archetype *archetype;
+        /// @brief index of the type in the destination types (add) or in the source types (remove)
+        uint32_t indexInTypeArray;
+    };
+    /// @brief cached column remap between two archetypes, see Archetype::convert
+    /// @details conversionColumns[columnsBegin, + columnCount) holds for every non zero sized destination column
+    /// the source column to copy or -1 to clear, followed by deallocateCount source columns to destruct.
+    struct ArchetypeConversion {
+        Archetype *archetype;
+        uint32_t columnsBegin;
+        uint16_t columnCount;
+        uint16_t deallocateCount;
+    };
     /**
      * @brief A structure holding single archetype of components.
      * in a normal case type[0] must be Entity but this class has
@@ -47,25 +67,44 @@ namespace ECS
         friend class ::Test;
 
         ArchetypeChunkData chunks;
-        /// @brief for archetypes with zero shared components
+        /// @brief for archetypes with zero shared components, empty otherwise
         std::vector<Chunk*,allocator<Chunk*>> chunksWithEmptySlots;
-        /// @brief for archetypes with shared components
+        /// @brief for archetypes with shared components, left uninitialized otherwise
         ChunkListMap freeChunksBySharedComponents;
+        /// @brief transition graph, filled lazily by EntityComponentStore::getArchetypeWithAddedComponent/RemovedComponent
+        std::vector<ArchetypeEdge> addEdges;
+        std::vector<ArchetypeEdge> removeEdges;
+        /// @brief conversion plans to other archetypes, filled lazily by convert
+        std::vector<ArchetypeConversion> conversions;
+        std::vector<int16_t> conversionColumns;
 
         // optimal for 16 component per archetype or less
         // 'Entity' are stored as the first type
         TypeID*   _types = nullptr;
         // faster access to TypeID::realIndecies() for iteration
         uint16_t* _realIndecies = nullptr;
-        /// @brief  components offsets in the chunks
+        /// @brief  components offsets in the chunks, typeCount offsets for each chunk size class
         uint32_t* _offsets = nullptr;
         uint16_t* _sizeOfs = nullptr;
-        TypeManager::DefaultFunction *_dDestructor = nullptr;
+        /// @brief CopyKernels::select of each _sizeOfs, used by column copies
+        CopyKernel* _copyKernels = nullptr;
+        /// @brief TypeManager::TypeInfo::destruct of each type, nullptr for trivially destructible ones
+        TypeManager::DestructFunction *_destructors = nullptr;
+        /// @brief TypeManager::TypeInfo::relocate of each type, nullptr for the ones moved by _copyKernels
+        TypeManager::RelocateFunction *_relocators = nullptr;
         TypeManager::DefaultFunction *_dConstructor = nullptr;
+        /// @brief TypeManager::TypeInfo::Prototype of each type
+        const void **_prototypes = nullptr;
         uint32_t typeCount;
-        // maximum number of entities that can be fit into a single chunk
-        uint32_t chunkCapacity = 0;
+        // maximum number of entities that can be fit into a single chunk of each size class, zero if the class is too small
+        uint32_t chunkCapacity[Chunk::SizeClassCount];
+        /// @brief size class of the companion chunk of each size class, Chunk::SizeClassCount if the archetype has no cold components
+        uint8_t coldSizeClass[Chunk::SizeClassCount];
+        /// @brief size class of newly allocated chunks, grows with the population
+        uint8_t sizeClass = 0;
         uint32_t entityCount = 0;
+        /// @brief consecutive EntityComponentStore::collectEmptyArchetypes calls that found the archetype empty
+        uint32_t emptyFrames = 0;
 
         // Order of components in the types array is always:
         // Entity, native component data, shared components, tag components
@@ -81,23 +120,31 @@ namespace ECS
 
         /// @brief archetype index in ECS archetype list, used for backward access.
         uint32_t archetypeIndex=0;
-        /// @brief used by EntityQueryManager
-        uint32_t matchingQueryCount = 0;
 
         ArchetypeFlags flags;
 
         EntityComponentStore *entityComponentStore;
         Archetype* nextChangedArchetype = nullptr;
-        /// @brief used by EntityQueryManager
-        EntityQueryData* matchingQueryData[Constants::MaximumQueryCount];
-        /// @brief used by EntityQueryManager
-        std::bitset<Constants::MaximumQueryCount> queryMask;
+        /// @brief used by EntityQueryManager, queries matching this archetype
+        /// @details sized to the real match count, usually a handful out of Constants::MaximumQueryCount
+        std::vector<EntityQueryData*> matchingQueryData;
 
         void addToChunkListWithEmptySlots(Chunk* chunk);
         void removeFromChunkListWithEmptySlots(Chunk* chunk);
     private:
         void emptySlotTrackingRemoveChunk(Chunk* chunk);
         void emptySlotTrackingAddChunk(Chunk* chunk);
+        /// @brief emptyFrames of an archetype being retired
+        static constexpr uint32_t RetiredMark = UINT32_MAX;
+        /// @brief cached edge for type, nullptr if never taken
+        static inline const ArchetypeEdge* findEdge(const std::vector<ArchetypeEdge> &edges, TypeID type) {
+            for (const ArchetypeEdge &edge:edges)
+                if (edge.type == type)
+                    return &edge;
+            return nullptr;
+        }
+        /// @brief column remap from this archetype to dstArchetype, built on first use
+        ArchetypeConversion getConversion(Archetype *dstArchetype);
         Chunk* getExistingChunkWithEmptySlots(const SharedComponentValues sharedComponentValues);
     public:
         inline uint32_t numNonZeroSizedTypes() const {return firstTagComponent;}
@@ -110,7 +157,13 @@ namespace ECS
         inline uint32_t count() const { return entityCount; }
         inline const_span<Chunk*>   getChunks() const {return  this->chunks.getChunkArray(); }
         inline const_span<TypeID>   getTypes()  const {return {this->_types,  this->typeCount};}
-        inline const_span<uint32_t> getOffset() const {return {this->_offsets,this->typeCount};}
+        inline const_span<uint32_t> getOffset(uint32_t chunkSizeClass) const {return {this->_offsets + chunkSizeClass * this->typeCount,this->typeCount};}
+        inline const_span<uint32_t> getOffset(const Chunk *chunk) const {return getOffset(chunk->sizeClass);}
+        inline uint32_t getChunkCapacity(uint32_t chunkSizeClass) const {return this->chunkCapacity[chunkSizeClass];}
+        inline uint32_t getChunkCapacity(const Chunk *chunk) const {return this->chunkCapacity[chunk->sizeClass];}
+        inline uint8_t getSizeClass() const {return this->sizeClass;}
+        inline bool hasColdComponents() const {return this->coldSizeClass[0] != Chunk::SizeClassCount;}
+        inline uint8_t getColdSizeClass(uint32_t chunkSizeClass) const {return this->coldSizeClass[chunkSizeClass];}
         inline const_span<uint16_t> getSize()   const {return {this->_sizeOfs,this->typeCount};}
         inline const_span<uint16_t> getIndex()  const {return {this->_realIndecies,this->typeCount};}
         Archetype& operator =(const Archetype&) = delete;
@@ -132,10 +185,17 @@ namespace ECS
         /// @brief Check if non-zero-sized components are same. Means chunks can be moved between archetypes.
         static bool areLayoutCompatible(Archetype *a, Archetype *b);
     private:
+        inline const uint32_t* offsetsOf(const Chunk *chunk) const {return this->_offsets + chunk->sizeClass * this->typeCount;}
+        /// @brief the chunk a column lives in, cold columns live in the companion chunk
+        static inline uint8_t* columnChunk(const Chunk *chunk, TypeID type) {return (uint8_t*)(type.isCold() ? chunk->companion : chunk);}
         void releaseChunk(Chunk* chunk);
         void setChunkCount(Chunk* chunk, uint32_t newCount);
 
-        void initializeComponents(Chunk* chunk, uint32_t dstIndex, uint32_t count);
+        /// @brief default initialize new components, pattern-fill of the type prototype, memset or per entity constructor
+        /// @param skip columns written by the caller, left untouched
+        void initializeComponents(Chunk* chunk, uint32_t dstIndex, uint32_t count, const_span<ComponentColumn> skip = {});
+        /// @brief default initialize count components of the t-th type in a column
+        void initializeColumn(uint8_t *column, uint32_t t, uint32_t dstIndex, uint32_t count) const;
         /// @brief allocating space into a chunk (updating entity count)
         /// @param chunk the chunk
         /// @param count number of entites
@@ -147,6 +207,18 @@ namespace ECS
         /// @param entities result allocated entities
         /// @return actuall allocated entity count if not enough space was available
         uint32_t allocate(Chunk* chunk, uint32_t count, Entity *entities = nullptr);
+        /// @brief allocate few new entities in a given chunk and copy their initial values from columns
+        /// @param columns validated by EntityComponentStore::createEntities
+        /// @param sourceIndex index of the first copied element in every column
+        uint32_t allocate(Chunk* chunk, uint32_t count, Entity *entities, const_span<ComponentColumn> columns, uint32_t sourceIndex);
+        /// @brief place few reserved entities in a given chunk, see EntityStore::reserveEntities
+        /// @param entities validated by EntityComponentStore::createReservedEntities
+        /// @return actuall placed entity count if not enough space was available
+        uint32_t allocateReserved(Chunk* chunk, uint32_t count, const Entity *entities);
+        /// @brief allocate few new entities in a given chunk holding copies of the components of a prototype entity
+        /// @param prototypeChunk chunk of this archetype holding the prototype, may be chunk itself
+        /// @return actuall allocated entity count if not enough space was available
+        uint32_t instantiate(Chunk* chunk, uint32_t count, Entity *entities, const Chunk *prototypeChunk, uint32_t prototypeIndex);
         void deallocate(Chunk *chunk);
         /// @brief deallocate and remove a batch of entities.
         /// @note may remove the chunk if chunk empties entirely.
@@ -170,8 +242,13 @@ namespace ECS
         void setSharedComponentDataIndex(Entity entity, const SharedComponentValues sharedComponentValues, TypeID typeIndex);
         void setSharedComponentDataIndex(Chunk *chunk, const SharedComponentValues sharedComponentValues, TypeID typeIndex);
         void setSharedComponentDataIndex(EntityBatchInChunk batch, const SharedComponentValues sharedComponentValues, TypeID typeIndex);
+        /// @note AoSoA columns (TypeID::isAoSoA) can only be addressed at block boundaries, use AoSoAColumn to reach single components
         const uint8_t* getComponentDataWithTypeRO(const Chunk *chunk, uint32_t baseEntityIndex, TypeID typeIndex) const;
         const uint8_t* getComponentDataRO(const Chunk *chunk, uint32_t baseEntityIndex, uint32_t indexInTypeArray) const;
+        /// @brief start of a column without any check nor version change, for prefetching
+        inline const uint8_t* getColumn(const Chunk *chunk, uint32_t indexInTypeArray) const {
+            return columnChunk(chunk, this->_types[indexInTypeArray]) + this->offsetsOf(chunk)[indexInTypeArray];
+        }
         uint8_t* getComponentDataWithTypeRW(const Chunk *chunk, uint32_t baseEntityIndex, TypeID typeIndex, Version globalSystemVersion);
         uint8_t* getComponentDataRW(const Chunk *chunk, uint32_t baseEntityIndex, uint32_t indexInTypeArray, Version globalSystemVersion);
     #pragma endregion ChunkDataUtility
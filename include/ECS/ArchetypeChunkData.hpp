@@ -7,10 +7,8 @@
 #include "Base/SharedComponent.hpp"
 #include "Base/Version.hpp"
 #include "Base/Constants.hpp"
-#include <bitset>
 namespace ECS
 {
-    using EnabledBitset = std::bitset<Constants::MaximumEntitiesPerChunk>;
     class Archetype;
     /** @brief there is a component version for each compopnent. 
      * any write access, whitout check for real value change, causes to update version to lastest version.
@@ -26,7 +24,7 @@ namespace ECS
         Chunk** _Chunk = nullptr;
         Version* _ChangeVersion = nullptr;
         SharedComponentIndex* _SharedComponentValue = nullptr;
-        EnabledBitset* _ComponentEnabledBit = nullptr;
+        uint64_t* _ComponentEnabledBit = nullptr;
         void *buckEnd = nullptr;
 
         // maximum number of chunks information that can be stored, before grow
@@ -37,13 +35,15 @@ namespace ECS
         const uint32_t sharedComponentCount;
         // total number (tags and shared components included)
         const uint32_t componentCount;
+        // number of 64 bit words of a single enabled bitset, enough for the largest chunk of the archetype
+        uint32_t enabledWordCount = Constants::MaximumEntitiesPerChunk / 64;
 
         // ChangeVersions and SharedComponentValues stored like:
         //  Type[        0         ]: [chunk[0] ... chunk[capacity - 1]]
         //  Type[       ...        ]: [         ...                    ]
         //  Type[componentCount - 1]: [chunk[0] ... chunk[capacity - 1]]
 
-        // ComponentEnabledBits stored like:
+        // ComponentEnabledBits stored like (each Type entry is enabledWordCount words):
         //  chunk[      0     ]: [Type[0] ... Type[componentCount - 1]]
         //  chunk[     ...    ]: [        ...                         ]
         //  chunk[capacity - 1]: [Type[0] ... Type[componentCount - 1]]
@@ -79,6 +79,9 @@ namespace ECS
         bool insideAllocation(void *addr) {
             return (buck.get() != nullptr) && (buck.get() <= addr) && (addr <= buckEnd);
         }
+        /// @brief sizes the enabled bits for chunks of at most entityCapacity entities
+        /// @details must be called before the first chunk is added
+        void setEntityCapacity(uint32_t entityCapacity);
         inline const_span<Chunk*> getChunkArray() const { return {_Chunk, this->_count}; }
         span<Version> getChangeVersionArrayForType(uint32_t component_index_in_archetype);
         Version getChangeVersion(uint32_t component_index_in_archetype, uint32_t index) const;
@@ -0,0 +1,130 @@
+#if !defined(AOSOA_HPP)
+#define AOSOA_HPP
+
+#include <string.h>
+#include <type_traits>
+#include "Chunk.hpp"
+#include "Constants.hpp"
+
+namespace ECS
+{
+    /// @brief Addressing of component columns stored as AoSoA blocks, see TypeManager::StorageLayout.
+    /// @details BlockSize consecutive entities of a sizeOf bytes component form a block of
+    /// sizeOf / FieldSize rows, row f holds field f of every entity of the block:
+    /// x0..x7 y0..y7 z0..z7 | x8..x15 y8..y15 z8..z15 | ...
+    /// every row is RowSize bytes and RowSize aligned, a row is a single vector load.
+    struct AoSoA final {
+        static constexpr uint32_t BlockSize = Constants::AoSoABlockSize;
+        static constexpr uint32_t FieldSize = Constants::AoSoAFieldSize;
+        static constexpr uint32_t RowSize = BlockSize * FieldSize;
+        static_assert(Constants::ChunkColumnAlignment % RowSize == 0);
+        static_assert((BlockSize & (BlockSize - 1)) == 0);
+
+        /// @brief number of blocks holding count entities, the last one may be partial
+        static constexpr uint32_t getBlockCount(uint32_t count) {return (count + BlockSize - 1) / BlockSize;}
+        /// @brief bytes of a single block of sizeOf bytes components
+        static constexpr uint32_t getBlockSize(uint32_t sizeOf) {return BlockSize * sizeOf;}
+        /// @brief same as Chunk::getPaddedCount, the column also holds whole blocks
+        static constexpr uint32_t getPaddedCount(uint32_t count, uint32_t sizeOf) {
+            const uint32_t lanes = Chunk::getLaneCount(sizeOf) > BlockSize ? Chunk::getLaneCount(sizeOf) : BlockSize;
+            return (count + lanes - 1) & ~(lanes - 1);
+        }
+        /// @brief byte offset of a field of the entity 'index' from the column start
+        static constexpr uint32_t getFieldOffset(uint32_t index, uint32_t field, uint32_t sizeOf) {
+            return (index / BlockSize) * getBlockSize(sizeOf) + field * RowSize + (index % BlockSize) * FieldSize;
+        }
+        /// @brief gathers the component of entity 'index' into a plain struct
+        static inline void load(const uint8_t *column, uint32_t index, uint32_t sizeOf, void *out) {
+            const uint8_t *src = column + getFieldOffset(index, 0, sizeOf);
+            uint8_t *dst = (uint8_t*)out;
+            for (uint32_t f = 0; f < sizeOf; f += FieldSize, src += RowSize)
+                memcpy(dst + f, src, FieldSize);
+        }
+        /// @brief scatters a plain struct into the component of entity 'index'
+        static inline void store(uint8_t *column, uint32_t index, uint32_t sizeOf, const void *in) {
+            uint8_t *dst = column + getFieldOffset(index, 0, sizeOf);
+            const uint8_t *src = (const uint8_t*)in;
+            for (uint32_t f = 0; f < sizeOf; f += FieldSize, dst += RowSize)
+                memcpy(dst, src + f, FieldSize);
+        }
+        /// @brief copies count components between two AoSoA columns, ranges must not overlap
+        /// @details runs that stay within a block on both sides are copied row by row, block aligned copies move whole rows.
+        static inline void copy(const uint8_t *srcColumn, uint32_t srcIndex, uint8_t *dstColumn, uint32_t dstIndex, uint32_t count, uint32_t sizeOf) {
+            const uint32_t rowCount = sizeOf / FieldSize;
+            while (count != 0)
+            {
+                uint32_t run = BlockSize - (srcIndex % BlockSize);
+                if (run > BlockSize - (dstIndex % BlockSize))
+                    run = BlockSize - (dstIndex % BlockSize);
+                if (run > count)
+                    run = count;
+                const uint8_t *src = srcColumn + getFieldOffset(srcIndex, 0, sizeOf);
+                uint8_t *dst = dstColumn + getFieldOffset(dstIndex, 0, sizeOf);
+                for (uint32_t r = 0; r < rowCount; r++, src += RowSize, dst += RowSize)
+                    memcpy(dst, src, run * FieldSize);
+                srcIndex += run;
+                dstIndex += run;
+                count -= run;
+            }
+        }
+        /// @brief writes count copies of value starting at index, doubling copies of what is already written
+        static inline void fill(uint8_t *column, uint32_t index, uint32_t count, uint32_t sizeOf, const void *value) {
+            if (count == 0)
+                return;
+            store(column, index, sizeOf, value);
+            for (uint32_t written = 1; written < count; written *= 2)
+                copy(column, index, column, index + written, written < count - written ? written : count - written, sizeOf);
+        }
+        /// @brief zeroes count components starting at index
+        static inline void clear(uint8_t *column, uint32_t index, uint32_t count, uint32_t sizeOf) {
+            const uint32_t rowCount = sizeOf / FieldSize;
+            while (count != 0)
+            {
+                uint32_t run = BlockSize - (index % BlockSize);
+                if (run > count)
+                    run = count;
+                uint8_t *dst = column + getFieldOffset(index, 0, sizeOf);
+                for (uint32_t r = 0; r < rowCount; r++, dst += RowSize)
+                    memset(dst, 0, run * FieldSize);
+                index += run;
+                count -= run;
+            }
+        }
+    };
+
+    /// @brief Typed view over an AoSoA column for job code.
+    /// @details T is the registered component (const for read only access), F the type of its fields.
+    /// iterate blocks with AoSoA::getBlockCount(chunk->count) and process rows at full vector width,
+    /// lanes past chunk->count in the last block are padding.
+    template<typename T, typename F = float>
+    struct AoSoAColumn final {
+        using Byte  = std::conditional_t<std::is_const_v<T>, const uint8_t, uint8_t>;
+        using Field = std::conditional_t<std::is_const_v<T>, const F, F>;
+        static_assert(sizeof(F) == AoSoA::FieldSize);
+        static_assert(sizeof(T) % AoSoA::FieldSize == 0);
+        static constexpr uint32_t FieldCount = sizeof(T) / AoSoA::FieldSize;
+
+        /// @param columnStart start of the column, Archetype::getComponentDataRO/RW(chunk, 0, indexInTypeArray)
+        explicit AoSoAColumn(Byte *columnStart) : column{columnStart} {}
+        /// @brief AoSoA::BlockSize values of a single field, AoSoA::RowSize aligned
+        inline Field* row(uint32_t block, uint32_t field) const {
+            return (Field*)(this->column + block * AoSoA::getBlockSize(sizeof(T)) + field * AoSoA::RowSize);
+        }
+        inline Field& at(uint32_t index, uint32_t field) const {
+            return *(Field*)(this->column + AoSoA::getFieldOffset(index, field, sizeof(T)));
+        }
+        inline std::remove_const_t<T> load(uint32_t index) const {
+            std::remove_const_t<T> value;
+            AoSoA::load(this->column, index, sizeof(T), &value);
+            return value;
+        }
+        template<typename U = T, typename = std::enable_if_t<!std::is_const_v<U>>>
+        inline void store(uint32_t index, const T &value) const {
+            AoSoA::store(this->column, index, sizeof(T), &value);
+        }
+    private:
+        Byte *column;
+    };
+} // namespace ECS
+
+#endif
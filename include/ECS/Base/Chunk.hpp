@@ -6,6 +6,7 @@
 namespace ECS
 {
     class Archetype;
+    struct ChunkSlab;
     struct ChunkIndex {
         constexpr ChunkIndex() = default;
         constexpr ChunkIndex(const uint32_t v):value{v}{}
@@ -33,22 +34,55 @@ namespace ECS
         // MAGIC NUMBER. Header size. DO NOT TOUCH.
         /// @details Considerations: must be cache line aligned
         static constexpr uint32_t MemoryOffset = Constants::CacheLineSize;
-        // MAGIC NUMBER. Chunk size. DO NOT TOUCH.
+        // MAGIC NUMBER. Number of chunk sizes.
+        static constexpr uint32_t SizeClassCount = 3;
+        // MAGIC NUMBER. Chunk sizes, ascending.
         /// @details Considerations: any number larger than 0xFFFF may cause overflow in offset array!
-        static constexpr uint32_t MemorySize = 16 * 1024;
+        /// must divide ChunkStore::SlabSize.
+        static constexpr uint32_t SizeClassMemorySize[SizeClassCount] = {4 * 1024, 16 * 1024, 64 * 1024};
+        /// @brief Maximum number of entities per chunk of each class.
+        /// @details smaller chunks keep the version-ing granularity, the largest one removes per chunk overhead of hot archetypes.
+        static constexpr uint32_t SizeClassEntityLimit[SizeClassCount] = {192, 192, Constants::MaximumEntitiesPerChunk};
+        static constexpr uint32_t getMemorySize(uint32_t sizeClass) {return SizeClassMemorySize[sizeClass];}
         /// @brief Maximum usable memory size
-        static constexpr uint32_t BufferSize = MemorySize - MemoryOffset;
+        static constexpr uint32_t getBufferSize(uint32_t sizeClass) {return SizeClassMemorySize[sizeClass] - MemoryOffset;}
         Archetype *archetype = nullptr;
         uint32_t count = 0;
         // index in chunksWithEmptySlots or freeChunksBySharedComponents
          int32_t listWithEmptySlotsIndex = -1;
         // index in ArchetypeChunkData
          int32_t listIndex = -1;
-        /// @brief actual buffer
         ChunkIndex index = ChunkIndex();
-        alignas(MemoryOffset) mutable uint8_t buffer[BufferSize];
+        /// @brief the slab this chunk memory was carved out of, owned by ChunkStore
+        ChunkSlab *slab = nullptr;
+        /// @brief index in SizeClassMemorySize, fixed for the chunk lifetime
+        uint8_t sizeClass = 0;
+        /// @brief NUMA node owning the chunk memory, see ChunkStore::getNodeCount
+        uint8_t node = 0;
+        /// @brief chunk holding the cold columns of the archetype (TypeID::isCold), nullptr if it has none
+        /// @details owned by this chunk, same entity indices, its own header is unused except index and sizeClass
+        Chunk *companion = nullptr;
+        /// @brief actual buffer, getBufferSize(sizeClass) bytes
+        alignas(MemoryOffset) mutable uint8_t buffer[];
+
+        /// @brief number of elements vector loops may process in a column, count rounded up to the lane count of the element size
+        /// @details every column starts at a multiple of Constants::ChunkColumnAlignment (or the component alignment if larger)
+        /// and elements in [count, getPaddedCount(count, sizeOf)) are addressable padding or unused slots, so loops can use
+        /// aligned loads and stores without a scalar remainder. their content is unspecified.
+        static constexpr uint32_t getPaddedCount(uint32_t count, uint32_t sizeOf) {
+            return sizeOf == 0 ? count : (count + getLaneCount(sizeOf) - 1) & ~(getLaneCount(sizeOf) - 1);
+        }
+        /// @brief number of elements of sizeOf bytes needed to fill a whole vector register, at most Constants::ChunkColumnLaneCount
+        static constexpr uint32_t getLaneCount(uint32_t sizeOf) {
+            // sizeOf & -sizeOf: largest power of 2 dividing the size
+            const uint32_t granularity = (sizeOf & (0u - sizeOf)) < Constants::ChunkColumnAlignment ? (sizeOf & (0u - sizeOf)) : Constants::ChunkColumnAlignment;
+            const uint32_t lanes = Constants::ChunkColumnAlignment / granularity;
+            return lanes < Constants::ChunkColumnLaneCount ? lanes : Constants::ChunkColumnLaneCount;
+        }
+        inline uint32_t memorySize() const {return getMemorySize(sizeClass);}
+        inline uint32_t bufferSize() const {return getBufferSize(sizeClass);}
     };
-    static_assert(sizeof(Chunk) == Chunk::MemorySize);
+    static_assert(sizeof(Chunk) == Chunk::MemoryOffset);
 }
 
 #endif
\ No newline at end of file
@@ -12,9 +12,27 @@ namespace ECS {
         static constexpr uint32_t CacheLineSize = 0x40;
         static constexpr uint32_t CacheLineFit = 0x3F;
         static constexpr uint32_t CacheLineMask = 0xFFFFFFC0;
+        /// @brief MAGIC NUMBER, every chunk column starts at a multiple of this, the widest vector register (AVX-512)
+        /// @details Considerations: must be power of 2 and a multiple of CacheLineSize
+        static constexpr uint32_t ChunkColumnAlignment = 0x40;
+        /// @brief MAGIC NUMBER, upper bound for the number of elements a vector loop processes at once, see Chunk::getPaddedCount
+        /// @details Considerations: must be power of 2
+        static constexpr uint32_t ChunkColumnLaneCount = 16;
+        /// @brief MAGIC NUMBER, number of entities interleaved in a block of an AoSoA column, one 32 bit field per AVX2 lane
+        /// @details Considerations: must be power of 2, BlockSize * AoSoAFieldSize must divide ChunkColumnAlignment
+        static constexpr uint32_t AoSoABlockSize = 8;
+        /// @brief MAGIC NUMBER, size of a single field (lane) of an AoSoA component, float or int32
+        static constexpr uint32_t AoSoAFieldSize = 4;
         // lower the number, the better component version-ing performs,
+        /// @brief upper bound for every chunk size class, see Chunk::SizeClassEntityLimit
         /// @details Considerations: ArchetypeChunkData uses bitset as enabling bit per type for entities in a chunk so it must be multiply of 64.
-        static constexpr uint32_t MaximumEntitiesPerChunk = 192;
+        static constexpr uint32_t MaximumEntitiesPerChunk = 512;
+        /// @brief number of chunks an archetype fills before its new chunks use the next size class
+        static constexpr uint32_t SizeClassPromotionChunkCount = 4;
+        /// @brief number of chunks with empty slots compared to pick the fullest one for new entities
+        static constexpr uint32_t FillPolicyScanCount = 8;
+        /// @brief maximum number of entities moved by a single defragmentation pass of the system loop
+        static constexpr uint32_t DefragmentEntityBudget = 0x400;
         /// @details Considerations: must be power of 2
         static constexpr uint32_t MaximumQueryCount = 512;
         static constexpr uint32_t MaximumQueryTypesCount = 32;
@@ -33,11 +51,18 @@ namespace ECS {
         static constexpr uint16_t MaximumResourcesCount = 1 << 8;
         static constexpr uint16_t ResourceBlockCount = 1 << 8;
         static constexpr uint16_t ResourceBlockSize = 1 << 8;
-        static constexpr uint32_t MaximumChunkCount = 0x10000;
+        /// @brief default number of chunks a chunk job looks ahead to prefetch, zero disables prefetching
+        static constexpr uint32_t ChunkPrefetchDistance = 2;
+        /// @brief Maximum number of NUMA nodes ChunkStore keeps separate pools for, higher nodes share the last pool.
+        static constexpr uint32_t MaximumNodeCount = 8;
+        /// @brief ChunkStore grows its directory on demand up to this number of chunks.
+        static constexpr uint32_t MaximumChunkCount = 0x1000000;
         static constexpr uint32_t MaxJobCount = 0xFFFFF;
         static constexpr uint32_t InitialSystemCapacity = 0x80;
         static constexpr uint32_t InitialArchetypeArraySize = 0x80;
         static constexpr uint32_t InitialChunkListSize = 0x80;
+        /// @brief one cache line of chunk pointers, Archetype::chunksWithEmptySlots grows from there
+        static constexpr uint32_t InitialEmptySlotListSize = 0x8;
         static constexpr uint32_t InitialArchetypeCacheSize = 0x80;
         static constexpr uint32_t InitialChunkCacheSize = 0x100;
         static constexpr uint32_t InitialSharedComponentChunkCapacity = 0x20;
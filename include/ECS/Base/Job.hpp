@@ -31,6 +31,10 @@ namespace ECS
         uint32_t batchCount = 1;
         uint32_t batchStepSize = 1;
         JobHandle dependsOn = JobHandle();
+        /// @brief optional, batches grouped by NUMA node: node n owns batches [nodeBatchBegin[n], nodeBatchBegin[n+1])
+        /// @details workers start with the batches of their own node, then help the other nodes.
+        const uint32_t *nodeBatchBegin = nullptr;
+        uint32_t nodeCount = 1;
     };
 }
 
@@ -32,6 +32,8 @@ namespace ECS {
         inline bool isZeroSized() const;
         inline bool isManagedComponent() const ;
         inline bool hasAssetRef() const;
+        inline bool isAoSoA() const;
+        inline bool isCold() const;
         static bool compare(const_span<TypeID> v1,const_span<TypeID> v2)
         {
             if (v1.size() != v2.size())
@@ -57,6 +59,12 @@ namespace ECS {
         /// @details Considerations: SharedComponent must comes before ZeroSized components
         static constexpr uint32_t ManagedComponentTypeFlag = 1 << 17;
         static constexpr uint32_t AssetRefFlag             = 1 << 18;
+        /// @brief MAGIC NUMBER, the component column is stored as AoSoA blocks, see AoSoA
+        /// @details Considerations: must be below ManagedComponentTypeFlag, AoSoA components sort with native components
+        static constexpr uint32_t AoSoAStorageFlag         = 1 << 16;
+        /// @brief MAGIC NUMBER, the component column lives in the companion chunk, see Chunk::companion
+        /// @details Considerations: must be below ManagedComponentTypeFlag, cold components sort with native components
+        static constexpr uint32_t ColdStorageFlag          = 1 << 15;
         static constexpr uint32_t ClearFlagsMask = Constants::MaximumTypesCount-1;
         enum class TypeCategory : uint16_t {
             /// Implements IComponentData (can be either a struct or a class)
@@ -66,7 +74,21 @@ namespace ECS {
             /// Is an Entity
             Entity,
         };
+        /// @brief How the column of a component is laid out in chunks
+        enum class StorageLayout : uint8_t {
+            /// one component after the other (array of structs)
+            AoS = 0,
+            /// blocks of Constants::AoSoABlockSize components, field by field (array of structs of arrays)
+            /// @details only for plain components made of 32 bit fields, e.g. float x,y,z
+            AoSoA,
+            /// array of structs in a companion chunk, for rarely read data that should not dilute hot chunks
+            Cold,
+        };
         typedef void(*DefaultFunction)(void*);
+        /// @brief destroys count consecutive components
+        typedef void(*DestructFunction)(void *ptr, uint32_t count);
+        /// @brief moves count consecutive components into uninitialized memory and destroys the sources, ranges must not overlap
+        typedef void(*RelocateFunction)(void *dst, void *src, uint32_t count);
         struct TypeInfo {
             TypeID       TypeIndex;
             /// @brief Blittable size of the component type.
@@ -83,9 +105,20 @@ namespace ECS {
             uint32_t     AssetRefOffsetCount = 0;
             DefaultFunction defaultConstruct = nullptr;
             DefaultFunction defaultDestruct = nullptr;
+            /// @brief default value of trivially copyable components, pattern-filled into new columns
+            /// @details nullptr if the default value is all zero bytes (plain memset) or the type is not trivially copyable (defaultConstruct per entity)
+            const void  *Prototype = nullptr;
+            /// @brief batched destructor, nullptr if the type is trivially destructible
+            DestructFunction destruct = nullptr;
+            /// @brief batched move constructor and destructor, nullptr if the type is trivially relocatable (a memcpy moves it)
+            RelocateFunction relocate = nullptr;
             const char  *Name = nullptr;
             /// @brief Returns true if the component does not require space in Chunk memory
             bool         IsZeroSized() {return SizeInChunk==0;}
+            /// @brief Returns true if destroying the component is a no-op
+            bool         IsTriviallyDestructible() const {return destruct==nullptr;}
+            /// @brief Returns true if the component can be moved by copying its bytes
+            bool         IsTriviallyRelocatable() const {return relocate==nullptr;}
         };
     private:
         static uint32_t    initialized;
@@ -121,7 +154,7 @@ namespace ECS {
             return sharedTypeInfos[index].Name;
         }
         template<typename T>
-        static TypeID registerType(const char* name, const_span<uint16_t> assetRefs = {}) {
+        static TypeID registerType(const char* name, const_span<uint16_t> assetRefs = {}, StorageLayout layout = StorageLayout::AoS) {
             if(!initialized)
                 Initialize();
             // MAGIC NUMBER
@@ -131,6 +164,17 @@ namespace ECS {
             if(unlikely(typeCount >= Constants::MaximumTypesCount))
                 throw std::runtime_error("registerType(): Constants::MaximumTypesCount");
 
+            if(layout == StorageLayout::AoSoA){
+                if(!std::is_base_of_v<IComponentData,T> || std::is_base_of_v<IManagedComponentData,T> || std::is_empty_v<T> || !std::is_trivially_copyable_v<T>)
+                    throw std::invalid_argument("registerType(): AoSoA storage requires a trivially copyable, non-empty, unmanaged IComponentData");
+                if(sizeof(T) % Constants::AoSoAFieldSize != 0 || alignof(T) > Constants::AoSoAFieldSize)
+                    throw std::invalid_argument("registerType(): AoSoA storage requires a component made of 32 bit fields");
+                if(!assetRefs.empty())
+                    throw std::invalid_argument("registerType(): AoSoA storage does not support asset references");
+            }
+            if(layout == StorageLayout::Cold && (!std::is_base_of_v<IComponentData,T> || std::is_base_of_v<IManagedComponentData,T> || std::is_empty_v<T>))
+                throw std::invalid_argument("registerType(): cold storage requires a non-empty, unmanaged IComponentData");
+
             uint32_t index = typeCount++;
 
             uint32_t value = index;
@@ -142,6 +186,10 @@ namespace ECS {
                 value |= ZeroSizeInChunkTypeFlag;
             if(!assetRefs.empty())
                 value |= AssetRefFlag;
+            if(layout == StorageLayout::AoSoA)
+                value |= AoSoAStorageFlag;
+            if(layout == StorageLayout::Cold)
+                value |= ColdStorageFlag;
             sharedTypeInfos[index].TypeIndex = TypeID::fromIndex(value);
 
             sharedTypeInfos[index].TypeSize = sizeof(T);
@@ -177,6 +225,32 @@ namespace ECS {
 
             sharedTypeInfos[index].defaultDestruct  = [](void* x){static_cast<T*>(x)->~T();};
             sharedTypeInfos[index].defaultConstruct = [](void* x){new (static_cast<T*>(x)) T();};
+            if constexpr (!std::is_trivially_destructible_v<T>)
+                sharedTypeInfos[index].destruct = [](void* x, uint32_t count){
+                    T *p = static_cast<T*>(x);
+                    for (uint32_t i = 0; i < count; i++)
+                        p[i].~T();
+                };
+            // C++17 has no trivially relocatable trait, trivially copyable types are the ones known to survive a memcpy
+            if constexpr (!std::is_trivially_copyable_v<T>) {
+                static_assert(std::is_move_constructible_v<T>);
+                sharedTypeInfos[index].relocate = [](void* dst, void* src, uint32_t count){
+                    T *d = static_cast<T*>(dst), *s = static_cast<T*>(src);
+                    for (uint32_t i = 0; i < count; i++){
+                        new (d + i) T(std::move(s[i]));
+                        s[i].~T();
+                    }
+                };
+            }
+            if constexpr (std::is_trivially_copyable_v<T> && !std::is_empty_v<T> && !std::is_base_of_v<IManagedComponentData,T>) {
+                static const T prototype{};
+                const uint8_t *bytes = (const uint8_t*)&prototype;
+                for (uint32_t i = 0; i < sizeof(T); i++)
+                    if (bytes[i] != 0) {
+                        sharedTypeInfos[index].Prototype = &prototype;
+                        break;
+                    }
+            }
             sharedTypeInfos[index].Name = name;
             return sharedTypeInfos[index].TypeIndex;
         }
@@ -186,6 +260,10 @@ namespace ECS {
     template<> TypeID __typeid__<std::nullptr_t>();
     template<> TypeID __typeid__<ECS::Entity>();
     #define DEF_TYPE(TYPE) template<> ECS::TypeID ECS::__typeid__<TYPE>(){static ECS::TypeID v = ECS::TypeManager::registerType<TYPE>(#TYPE);return v;}
+    /// @brief same as DEF_TYPE, the component is stored as AoSoA blocks in chunks
+    #define DEF_TYPE_AOSOA(TYPE) template<> ECS::TypeID ECS::__typeid__<TYPE>(){static ECS::TypeID v = ECS::TypeManager::registerType<TYPE>(#TYPE,{},ECS::TypeManager::StorageLayout::AoSoA);return v;}
+    /// @brief same as DEF_TYPE, the component is stored in companion chunks
+    #define DEF_TYPE_COLD(TYPE) template<> ECS::TypeID ECS::__typeid__<TYPE>(){static ECS::TypeID v = ECS::TypeManager::registerType<TYPE>(#TYPE,{},ECS::TypeManager::StorageLayout::Cold);return v;}
 
     uint32_t TypeID::index() const {return this->value & TypeManager::ClearFlagsMask;}
     uint32_t TypeID::flags() const {return this->value & ~TypeManager::ClearFlagsMask;}
@@ -193,6 +271,8 @@ namespace ECS {
     bool TypeID::isZeroSized() const {return this->value & TypeManager::ZeroSizeInChunkTypeFlag;}
     bool TypeID::isManagedComponent() const {return this->value & TypeManager::ManagedComponentTypeFlag;}
     bool TypeID::hasAssetRef() const {return this->value & TypeManager::AssetRefFlag;}
+    bool TypeID::isAoSoA() const {return this->value & TypeManager::AoSoAStorageFlag;}
+    bool TypeID::isCold() const {return this->value & TypeManager::ColdStorageFlag;}
 
     template<typename T>
     inline TypeID getTypeID() { return __typeid__<std::remove_const_t<std::remove_reference_t<T>>>(); }
@@ -95,6 +95,12 @@ namespace ECS
         /// @brief find a pointer with a key using hash list
         /// @return value or nullptr
         Chunk* tryGet(const SharedComponentValues sharedComponentValues, uint32_t numSharedComponents) const;
+        /// @brief like tryGet but walks the whole probe chain and picks the chunk with the most entities
+        /// @param exclude a chunk to skip, may be nullptr
+        Chunk* tryGetFullest(const SharedComponentValues sharedComponentValues, uint32_t numSharedComponents, const Chunk *exclude = nullptr) const;
+        /// @brief the stored chunk with the least entities
+        /// @return nullptr if empty
+        Chunk* getSparsest() const;
         bool contains(Chunk*) const;
     };
 }
@@ -3,24 +3,155 @@
 
 #include <array>
 #include <atomic>
+#include <vector>
 #include "Base/Chunk.hpp"
 #include "Base/Constants.hpp"
 
 namespace ECS
 {
+    /// @brief A large OS mapping that chunks are carved out of.
+    /// @details Freed chunks go back to the free list of their own slab, so a slab
+    /// can be handed back to the OS once all of its chunks are free.
+    struct ChunkSlab {
+        uint8_t   *memory = nullptr;
+        /// @brief recycled chunks of this slab, linked through their buffer
+        Chunk     *freeList = nullptr;
+        /// @brief chunks below this index were handed out at least once, the rest are untouched memory
+        uint32_t   carvedCount = 0;
+        /// @brief chunks currently in use
+        uint32_t   usedCount = 0;
+        /// @brief index in ChunkStore::slabs
+        uint32_t   slabIndex = 0;
+        /// @brief size class of every chunk in this slab
+        uint8_t    sizeClass = 0;
+        /// @brief NUMA node the slab memory is bound to
+        uint8_t    node = 0;
+        /// @brief neighbours in the list of slabs with free chunks
+        ChunkSlab *prev = nullptr;
+        ChunkSlab *next = nullptr;
+    };
+
     struct ChunkStore {
-        static constexpr uint32_t BitmaskSize = 32;
-        static constexpr uint32_t ChunkBunchCount = Constants::MaximumChunkCount / BitmaskSize;
+        static constexpr uint32_t BitmaskSize = 64;
+        /// @brief MAGIC NUMBER, number of chunk indices covered by a single directory segment
+        /// @details Considerations: must be power of 2 and multiply of BitmaskSize * BitmaskSize
+        static constexpr uint32_t SegmentShift = 14;
+        static constexpr uint32_t SegmentSize = 1u << SegmentShift;
+        static constexpr uint32_t SegmentMask = SegmentSize - 1;
+        static constexpr uint32_t SegmentCount = Constants::MaximumChunkCount / SegmentSize;
+        static constexpr uint32_t ChunkBunchCount = SegmentSize / BitmaskSize;
+        /// @brief number of words in the summary bitmap of a segment, each bit tells a bitmasks word is full
+        static constexpr uint32_t SummaryCount = ChunkBunchCount / BitmaskSize;
+        /// @brief number of words in the directory bitmap, each bit tells a segment is full
+        static constexpr uint32_t SegmentSummaryCount = (SegmentCount + BitmaskSize - 1) / BitmaskSize;
+        static_assert(SegmentSize % (BitmaskSize * BitmaskSize) == 0);
+        static_assert(Constants::MaximumChunkCount % SegmentSize == 0);
+        /// @brief MAGIC NUMBER, number of index caches, threads are spread over them
+        static constexpr uint32_t IndexCacheCount = 16;
+        /// @brief MAGIC NUMBER, number of chunk indices held by a single cache (fills a cache line)
+        static constexpr uint32_t IndexCacheSize = 14;
+        /// @brief MAGIC NUMBER, size of a single slab mapping (a huge page on x86-64)
+        static constexpr uint32_t SlabSize = 2 * 1024 * 1024;
+        /// @brief Default number of free bytes kept mapped before empty slabs get released.
+        static constexpr size_t DefaultReleaseWatermark = SlabSize * 2;
+        static constexpr uint32_t getChunksPerSlab(uint32_t sizeClass) {return SlabSize / Chunk::getMemorySize(sizeClass);}
+        static_assert(SlabSize % Chunk::SizeClassMemorySize[Chunk::SizeClassCount - 1] == 0);
     private:
-        std::array<std::atomic<Chunk*>,Constants::MaximumChunkCount> chunks;
-        std::array<std::atomic<uint32_t>,ChunkBunchCount> bitmasks;
+        /// @brief recently freed indices that are still marked as used in bitmasks
+        struct alignas(Constants::CacheLineSize) IndexCache {
+            std::atomic<uint32_t> busy{0};
+            uint32_t count = 0;
+            uint32_t indices[IndexCacheSize];
+        };
+        static_assert(sizeof(IndexCache) == Constants::CacheLineSize);
+        /// @brief bitmaps of SegmentSize chunk indices, allocated on demand and kept until the store dies
+        struct alignas(Constants::CacheLineSize) Segment {
+            /// @brief a set bit marks a full bitmasks word, only a hint for the search
+            std::atomic<uint64_t> summary[SummaryCount];
+            /// @brief a set bit marks a used index
+            std::atomic<uint64_t> bitmasks[ChunkBunchCount];
+        };
+        static constexpr size_t ChunkTableSize = sizeof(std::atomic<Chunk*>) * Constants::MaximumChunkCount;
+
+        /// @brief directory of segments, a published segment never moves
+        std::array<std::atomic<Segment*>,SegmentCount> segments;
+        /// @brief a set bit marks a full segment, only a hint for the search
+        std::array<std::atomic<uint64_t>,SegmentSummaryCount> segmentSummary;
+        /// @brief number of published segments
+        std::atomic<uint32_t> segmentCount{0};
+        /// @brief chunk of every index, a single load away for getChunkPointer
+        /// @details address space for Constants::MaximumChunkCount pointers is reserved up front,
+        /// the pages of a segment are committed when it is published
+        std::atomic<Chunk*> *chunkTable = nullptr;
+        std::array<IndexCache,IndexCacheCount> indexCaches;
+
+        /// @brief every mapped slab
+        std::vector<ChunkSlab*> slabs;
+        /// @brief slabs that have at least one chunk to hand out, per NUMA node and size class
+        ChunkSlab *partialSlabs[Constants::MaximumNodeCount][Chunk::SizeClassCount] = {};
+        /// @brief bytes mapped but not in use
+        size_t freeMemory = 0;
+        size_t releaseWatermark = DefaultReleaseWatermark;
+        bool hugePages = false;
+        std::atomic<uint32_t> poolLock{0};
+
+        /// @brief publishes segment number 'index' if no other thread did
+        void growSegments(uint32_t index);
+        /// @brief reserves a free index in a segment bitmap
+        /// @return false if the segment is full
+        static bool claimInSegment(Segment *segment, uint32_t &index);
+        /// @brief reserves a free index in the bitmap
+        ChunkIndex claimIndex();
+        /// @brief marks an index as free in the bitmap
+        void releaseIndex(uint32_t index);
+        /// @brief the index cache of the calling thread
+        IndexCache& threadIndexCache();
+        void lockPool();
+        void unlockPool();
+        ChunkSlab* mapSlab(uint8_t sizeClass, uint8_t node);
+        void unmapSlab(ChunkSlab *slab);
+        void linkPartialSlab(ChunkSlab *slab);
+        void unlinkPartialSlab(ChunkSlab *slab);
+        /// @brief takes a chunk memory out of the pool, maps a new slab if required
+        Chunk* takeChunk(uint8_t sizeClass, uint8_t node);
+        /// @brief returns a chunk memory to its slab, may release the slab
+        void giveChunk(Chunk *chunk);
     public:
-        ChunkStore() = default;
+        ChunkStore();
         ~ChunkStore();
-        Chunk* getChunkPointer(const ChunkIndex chunk);
-        ChunkIndex allocateChunk();
+        /// @brief the chunk of an index, nullptr if the index is not allocated
+        /// @details inline, EntityStore resolves every entity lookup through it
+        inline Chunk* getChunkPointer(const ChunkIndex chunk);
+        /// @brief allocates a chunk on the NUMA node of the calling thread
+        ChunkIndex allocateChunk(uint8_t sizeClass = 0);
+        ChunkIndex allocateChunk(uint8_t sizeClass, uint32_t node);
         void freeChunk(const ChunkIndex chunk);
+        /// @brief Number of free bytes to keep mapped before completely empty slabs are returned to the OS.
+        void setReleaseWatermark(size_t bytes);
+        /// @brief Back new slabs with huge pages (MAP_HUGETLB), falls back to transparent huge page advice.
+        void setHugePages(bool enable);
+        inline uint32_t getSlabCount() const {return (uint32_t)slabs.size();}
+        inline size_t getFreeMemory() const {return freeMemory;}
+        /// @brief number of chunk indices the directory currently covers
+        inline uint32_t getIndexCapacity() const {return segmentCount.load(std::memory_order_acquire) * SegmentSize;}
+        // NUMA topology, shared by every store
+        /// @brief Overrides the number of NUMA nodes, zero restores the detected topology.
+        /// @details A count different from the hardware one simulates nodes: pools and scheduling
+        /// are split as usual but memory is not bound and threads are not pinned.
+        static void setNodeCount(uint32_t count);
+        /// @brief number of NUMA nodes, 1 up to Constants::MaximumNodeCount
+        static uint32_t getNodeCount();
+        /// @brief Makes node the preferred node of the calling thread, pins the thread to the node CPUs on real topologies.
+        static void setThreadNode(uint32_t node);
+        /// @brief NUMA node of the calling thread, set by setThreadNode or taken from the CPU it runs on
+        static uint32_t getThreadNode();
     };
+    Chunk* ChunkStore::getChunkPointer(const ChunkIndex chunk) {
+        // pages past the published segments may not be committed
+        if(chunk >= getIndexCapacity())
+            return nullptr;
+        return this->chunkTable[chunk].load(std::memory_order_acquire);
+    }
 } // namespace ECS
 
 
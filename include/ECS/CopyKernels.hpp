@@ -0,0 +1,33 @@
+#if !defined(COPYKERNELS_HPP)
+#define COPYKERNELS_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace ECS
+{
+    /// @brief copies count elements of sizeOf bytes, ranges must not overlap
+    typedef void (*CopyKernel)(uint8_t *dst, const uint8_t *src, uint32_t count, uint32_t sizeOf);
+
+    /// @brief Column copy routines specialized by element size, see Archetype::_copyKernels.
+    /// @details single element moves of common sizes compile to a few register moves instead of a memcpy call,
+    /// batches go to memcpy which already is vectorized. copyStreaming is left to callers that know the destination
+    /// will not be read soon, streaming stores are twice as slow as memcpy when the data stays in cache.
+    struct CopyKernels final {
+        // MAGIC NUMBER, batch moves of this many bytes or more between archetypes use non-temporal stores
+        /// @details about the size of L1, such moves walk whole chunks that were not touched recently
+        static constexpr size_t StreamingThreshold = 32 * 1024;
+
+        /// @brief the kernel for elements of sizeOf bytes, generic one if the size has no specialization
+        static CopyKernel select(uint32_t sizeOf);
+        /// @brief size agnostic kernel, a single memcpy
+        static void copyGeneric(uint8_t *dst, const uint8_t *src, uint32_t count, uint32_t sizeOf);
+        /// @brief writes count copies of the sizeOf bytes at value, doubling memcpy of what is already written
+        /// @param value must not overlap dst
+        static void fill(uint8_t *dst, const void *value, uint32_t count, uint32_t sizeOf);
+        /// @brief copies bytes using non-temporal stores if the target supports them, memcpy otherwise
+        static void copyStreaming(uint8_t *dst, const uint8_t *src, size_t bytes);
+    };
+} // namespace ECS
+
+#endif
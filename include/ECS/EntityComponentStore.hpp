@@ -18,6 +18,18 @@ namespace ECS
 {
     struct Chunk;
     struct Archetype;
+    /// @brief initial values of a single component type for EntityComponentStore::createEntities
+    struct ComponentColumn {
+        TypeID type;
+        /// @brief tightly packed array of the component, one element per created entity
+        const void *data;
+    };
+    /// @brief result of a single EntityComponentStore::defragment pass
+    struct DefragmentStats {
+        uint32_t reclaimedChunks = 0;
+        size_t   reclaimedBytes = 0;
+        uint32_t movedEntities = 0;
+    };
     // the class that holds all entities
     struct EntityComponentStore final {
         friend class ::Test;
@@ -28,7 +40,7 @@ namespace ECS
         // contains index of it archetype and it index in that archetype
         ArchetypeListMap typeLookup;
         std::vector<std::unique_ptr<Archetype>> archetypes;
-        EntityStore entityStore{};
+        EntityStore entityStore{&chunks};
         // global version buffer, used for any entity create/modify command
         Version globalVersion = 1;
         ChunkListChanges chunkListChangesTracker;
@@ -37,15 +49,39 @@ namespace ECS
         ChunkStore chunks{};
         /// @brief used by EntityQueryManager
         uint32_t previousArchetypeCount = 0;
+        /// @brief next archetype to visit by defragment
+        uint32_t defragmentCursor = 0;
+        /// @brief frames an archetype must stay empty before collectEmptyArchetypes retires it, 0 disables the collector
+        uint32_t archetypeRetireFrames = 0;
     public:
         void cleanChangeList();
+        /// @brief merges sparse chunks of the same archetype and shared component values, freeing emptied chunks.
+        /// @details incremental, archetypes are visited round robin across passes.
+        /// @param entityBudget maximum number of entities to move in this pass
+        DefragmentStats defragment(uint32_t entityBudget = Constants::DefragmentEntityBudget);
+        /// @brief enables the empty archetype collector, see collectEmptyArchetypes
+        /// @param frames number of consecutive collectEmptyArchetypes calls an archetype must stay empty, 0 disables it
+        inline void setArchetypeRetireFrames(uint32_t frames) {this->archetypeRetireFrames = frames;}
+        /// @brief retires archetypes that stayed empty for the configured number of frames, meant to be called once per frame.
+        /// @details they are removed from the type lookup, the query caches and the transition graph, then freed.
+        /// pointers to a retired archetype are dangling, getOrCreateArchetype recreates it on demand.
+        /// @return number of retired archetypes
+        uint32_t collectEmptyArchetypes();
 
     #pragma region Archetype
     private:
         static void validateArchetype(const_span<TypeID> types);
-        static uint32_t getComponentArraySize(uint32_t componentSize, uint32_t entityCount);
-        static uint32_t calculateSpaceRequirement(const_span<uint16_t> componentSizes, uint32_t entityCount);
-        static uint32_t calculateChunkCapacity(const_span<uint16_t> componentSizes, uint32_t bufferSize);
+        /// @brief bytes of a column holding entityCount components, padded for vector loops
+        /// @param aosoa the column holds whole AoSoA blocks
+        static uint32_t getComponentArraySize(uint32_t componentSize, uint32_t entityCount, uint32_t alignment, bool aosoa = false);
+        /// @brief lays columns out from the chunk header
+        /// @param cold lay the cold columns (companion chunk) out instead of the hot ones
+        /// @param offsets optional, receives the column offsets from the chunk start, only the laid out columns are written
+        /// @return bytes used after the chunk header
+        static uint32_t calculateSpaceRequirement(const_span<TypeID> types, const_span<uint16_t> componentSizes, const_span<uint16_t> componentAlignments, uint32_t entityCount, bool cold = false, uint32_t *offsets = nullptr);
+        static uint32_t calculateChunkCapacity(const_span<TypeID> types, const_span<uint16_t> componentSizes, const_span<uint16_t> componentAlignments, uint32_t bufferSize, bool cold = false);
+        /// @brief smallest chunk size class holding population entities in one chunk, or the largest useful class
+        static uint8_t selectSizeClass(const Archetype* archetype, uint32_t population);
         /// @param types sorted array of types
         Archetype* createArchetype(const_span<TypeID> types);
         /// @brief seaarchin for a given type
@@ -67,7 +103,7 @@ namespace ECS
 
     #pragma region Chunk and Batch
     private:
-        Chunk *allocateChunk();
+        Chunk *allocateChunk(uint8_t sizeClass);
         inline void freeChunk(Chunk *chunk) {chunks.freeChunk(chunk->index);}
         Chunk* getCleanChunk(Archetype* archetype, const SharedComponentValues sharedComponentValues);
         Chunk* getChunkWithEmptySlots(Archetype* archetype, const SharedComponentValues sharedComponents);
@@ -76,6 +112,13 @@ namespace ECS
             return entityStore.getEntityInChunk(entity).chunk;
         }
         EntityBatchInChunk getFirstEntityBatchInChunk(const_span<Entity> entities);
+        /// @brief moves up to count entities from the end of srcChunk into dstChunk of the same archetype
+        /// @note releases srcChunk if it empties entirely.
+        /// @return number of entities moved
+        uint32_t compactChunk(Chunk *srcChunk, Chunk *dstChunk, uint32_t count);
+        /// @brief merges the sparsest chunks with empty slots of an archetype into the fullest ones
+        /// @return number of entities moved
+        uint32_t defragmentArchetype(Archetype *archetype, uint32_t entityBudget, DefragmentStats &stats);
         /// @brief Create a SharedComponent list based on the provided chunk, after changing the value of a shared component.
         /// @param chunk sourse chunk
         /// @param type the shared component type to modify
@@ -89,10 +132,35 @@ namespace ECS
     public:
         uint32_t countEntities();
         void createEntities(Archetype* archetype, span<Entity> entities, const SharedComponentValues values = SharedComponentValues());
+        /// @brief creates entities and copies their initial component values straight into the chunk columns
+        /// @details columns of types not listed are default initialized, versions are updated once per chunk.
+        /// @param columns unmanaged data components of the archetype, each type at most once
+        void createEntities(Archetype* archetype, span<Entity> entities, const_span<ComponentColumn> columns, const SharedComponentValues values = SharedComponentValues());
+        /// @brief creates clones of prefab, filled chunk by chunk in its archetype with the same shared component values
+        /// @details component bytes are replicated column-wise, managed components can not be cloned.
+        /// @param entities receives the new entities
+        void instantiate(Entity prefab, span<Entity> entities);
+        /// @brief hands out entity ids without creating them, safe to call from worker jobs
+        /// @param entities receives the reserved ids
+        inline void reserveEntities(span<Entity> entities){
+            entityStore.reserveEntities(entities);
+        }
+        /// @brief frees the ids reserved ahead by worker threads but not handed out, main thread only
+        inline void flushReservations(){
+            entityStore.flushReservations();
+        }
+        /// @brief creates reserved entities in chunks of archetype with default initialized components
+        /// @details main thread only, like every other structural change.
+        /// @param entities ids from reserveEntities, each not created yet and listed once
+        void createReservedEntities(Archetype* archetype, const_span<Entity> entities, const SharedComponentValues values = SharedComponentValues());
         bool exists(Entity entity);
         bool hasComponent(Entity entity, TypeID type);
+        /// @return the name or EntityName::Null(), see EntityStore::getEntityName
         const EntityName* getName(Entity entity);
         void setName(Entity entity, const EntityName* name);
+        /// @brief an existing entity named name, Entity() if there is none
+        /// @details hashed, costs nothing until the first setName
+        Entity findEntityByName(const EntityName &name);
     private:
         /// @brief Allocating some Entity's in entityStore
         /// @param arch 
@@ -109,6 +177,8 @@ namespace ECS
         /// @brief destroying a batch of entities.
         /// @details a wrapper to call arch->deallocate
         void destroyBatch(EntityBatchInChunk batch);
+        /// @brief destroying every entity of a chunk and releasing it, without the per entity bookkeeping of destroyBatch
+        void destroyChunk(Chunk* chunk);
         /// @brief Free all entities in a chunk from EntityStore
         void freeEntities(Chunk* chunk);
     public:
@@ -131,6 +201,10 @@ namespace ECS
         SharedComponentIndex getSharedComponentDataIndex(Entity entity, TypeID typeIndex);
         const void* getComponentDataWithTypeRO(Entity entity, TypeID typeIndex);
         void* getComponentDataWithTypeRW(Entity entity, TypeID typeIndex);
+        /// @brief copies the component of an entity into 'out', works for every storage layout
+        void getComponentData(Entity entity, TypeID typeIndex, void *out);
+        /// @brief overwrites the component of an entity, works for every storage layout
+        void setComponentData(Entity entity, TypeID typeIndex, const void *in);
     private:
         void moveAllSharedComponents(EntityComponentStore* srcEntityComponentStore);
         void incrementComponentOrderVersion(Archetype* archetype, const SharedComponentValues sharedComponentValues);
@@ -191,6 +265,13 @@ namespace ECS
         bool addComponents(EntityBatchInChunk entityBatchInChunk, const_span<TypeID> types);
         /// @param types sorted
         bool removeComponents(EntityBatchInChunk entityBatchInChunk, const_span<TypeID> types);
+        /// @brief adds type to every entity of an archetype, chunk at a time
+        /// @details layout compatible destinations (tags, shared components) retag whole chunks in place without copying data
+        /// @return number of entities changed
+        uint32_t addComponent(Archetype *archetype, TypeID type);
+        /// @brief removes type from every entity of an archetype, chunk at a time, see addComponent(Archetype*, TypeID)
+        /// @return number of entities changed
+        uint32_t removeComponent(Archetype *archetype, TypeID type);
     
     #pragma endregion move
 
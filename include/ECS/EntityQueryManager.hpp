@@ -1,6 +1,7 @@
 #if !defined(ENTITYQUERYMANAGER_HPP)
 #define ENTITYQUERYMANAGER_HPP
 
+#include <vector>
 #include "cutil/basics.hpp"
 #include "cutil/static_array.hpp"
 #include "Base/TypeID.hpp"
@@ -20,6 +21,10 @@ namespace ECS {
         inline bool isValid(){
             return validCache;
         }
+        /// @brief cached chunks are grouped by NUMA node, node n owns [nodeBegin[n], nodeBegin[n+1])
+        inline const_span<uint32_t> getNodeBegin() const {
+            return {nodeBegin, nodeCount + 1};
+        }
         ~EntityQueryData() = default;
     private:
         friend struct JobChunkWrapperBase;
@@ -42,6 +47,10 @@ namespace ECS {
         std::unique_ptr<ChunkCache[]>  cache;
         uint32_t             cacheCapacity = 0;
         uint32_t             cacheCount = 0;
+        /// @brief first cache index of each NUMA node
+        uint32_t             nodeBegin[Constants::MaximumNodeCount + 1] = {};
+        /// @brief highest NUMA node owning a cached chunk + 1
+        uint32_t             nodeCount = 1;
         struct TypeQuery {
             static const uint16_t WriteFlag = 1;
             static const uint16_t AnyFlag = 1 << 1;
@@ -80,9 +89,20 @@ namespace ECS {
         EntityQueryManager(EntityComponentStore *_ecs):ecs{_ecs}{}
         EntityQueryImpl createEntityQuery(const EntityQueryBuilder&);
         static void addArchetypeIfMatching(Archetype *archetype, EntityQueryData &query);
+        /// @brief drops archetype from the query cache, keeps the order of the others
+        static void removeArchetype(const Archetype *archetype, EntityQueryData &query);
         void addAdditionalArchetypes(span<Archetype*> archetypeList);
         static void rebuildMatchingChunkCache(EntityQueryData &query);
         void updateNewArchetypes();
+        /// @brief adds type to every entity matching the query, see EntityComponentStore::addComponent(Archetype*, TypeID)
+        /// @return number of entities changed
+        uint32_t addComponent(EntityQueryImpl query, TypeID type);
+        /// @brief removes type from every entity matching the query
+        /// @return number of entities changed
+        uint32_t removeComponent(EntityQueryImpl query, TypeID type);
+    private:
+        /// @brief archetypes matching the query, copied since structural changes create archetypes
+        void getMatchingArchetypes(EntityQueryImpl query, std::vector<Archetype*> &out);
     };
 }
 
@@ -2,38 +2,113 @@
 #define EntityStore_HPP
 
 #include <vector>
+#include <deque>
 #include <memory>
 #include <atomic>
+#include <array>
 #include "Base/Entity.hpp"
 #include "Base/TypeID.hpp"
 #include "Base/Chunk.hpp"
 #include "Base/Constants.hpp"
+#include "cutil/set.hpp"
 
 namespace ECS
 {
+    class ChunkStore;
     class EntityStore {
         // MAGIC NUMBER
         static constexpr uint32_t EntitiesInBlock = 8192;
         static constexpr uint32_t BlockCount = 4096;
         static constexpr uint32_t MaximumTheoreticalAmountOfEntities = EntitiesInBlock * BlockCount;
+        /// @brief EntityInChunk stored by chunk index, half the size of a pointer pair
+        struct PackedEntityInChunk
+        {
+            /// @brief resolved by ChunkStore::getChunkPointer, invalid if the entity has no chunk
+            ChunkIndex chunk = ChunkIndex();
+            uint16_t indexInChunk = 0;
+        };
+        static_assert(sizeof(PackedEntityInChunk) == 8 && Constants::MaximumEntitiesPerChunk <= 0x10000);
+        /// @brief chunk of ids handed out by reserveEntities, ids idle in a ReservationCache keep the invalid index
+        /// @details out of the ChunkStore range, resolves to nullptr like the invalid index
+        static constexpr uint32_t ReservedChunk = UINT32_MAX - 1;
+        static_assert(ReservedChunk >= Constants::MaximumChunkCount);
         struct DataBlock
         {
             uint32_t allocated[EntitiesInBlock / 32];
-            EntityInChunk entityInChunk[EntitiesInBlock];
+            PackedEntityInChunk entityInChunk[EntitiesInBlock];
             uint32_t versions[EntitiesInBlock];
-            EntityName names[EntitiesInBlock];
             DataBlock() = default;
         };
+        /// @brief names of the entities that have one, kept out of DataBlock since few entities are named
+        struct NameTable {
+            /// @brief getNameKey of an entity to its slot in names
+            set<uint32_t> slots;
+            /// @brief a deque, growing it does not move the names getEntityName pointers refer to
+            std::deque<EntityName> names;
+            /// @brief entity index owning each slot
+            std::vector<uint32_t> owners;
+            /// @brief getNameHash of a name to the first slot of the chain of slots sharing that hash
+            set<uint32_t> heads;
+            /// @brief next slot in the chain of each slot, ChainEnd for the last one
+            std::vector<uint32_t> next;
+            /// @brief unused slots in names
+            std::vector<uint32_t> freeSlots;
+            static constexpr uint32_t ChainEnd = UINT32_MAX;
+            /// @brief adds a named slot to the chain of its name
+            void link(uint32_t slot);
+            /// @brief removes a slot from the chain of its name, before the name changes
+            void unlink(uint32_t slot);
+        };
         static constexpr uint32_t BlockSize = sizeof(DataBlock);
         static constexpr uint32_t BlockBusy = ~0;
+        /// @brief MAGIC NUMBER, number of reservation caches, threads are spread over them
+        static constexpr uint32_t ReservationCacheCount = 16;
+        /// @brief MAGIC NUMBER, number of ids a reservation cache takes from the blocks at once
+        static constexpr uint32_t ReservationCacheSize = 63;
+        /// @brief ids allocated ahead for reserveEntities, not handed out yet
+        struct alignas(Constants::CacheLineSize) ReservationCache {
+            std::atomic<uint32_t> busy{0};
+            uint32_t count = 0;
+            Entity entities[ReservationCacheSize];
+        };
         align_ptr<DataBlock>  dataBlocks[BlockCount];
-        std::atomic<uint32_t> entityCount[BlockCount];
+        /// @brief zeroed here, the constructor taking a ChunkStore does not value-initialize the store
+        std::atomic<uint32_t> entityCount[BlockCount] = {};
+        /// @brief owner of the chunks entities point to, nullptr if entities are never placed in chunks
+        ChunkStore *chunkStore = nullptr;
+        /// @brief every block before it is full, where allocateEntities starts looking
+        std::atomic<uint32_t> firstFreeBlock{0};
+        std::array<ReservationCache,ReservationCacheCount> reservationCaches;
+        /// @brief allocated by the first setEntityName, guarded by nameLock
+        std::unique_ptr<NameTable> nameTable;
+        /// @brief blocks are locked one at a time, the name table shared by all of them has its own lock
+        std::atomic<uint32_t> nameLock{0};
+        /// @brief set once nameTable exists, lets deallocateEntities skip the lock while nothing is named
+        std::atomic<bool> hasNames{false};
 
         void ExistsOrThrow(uint32_t blockIndex, uint32_t indexInBlock);
         void integrityCheck(uint32_t blockIndex);
+        /// @brief the chunk of a packed entry, nullptr if there is none
+        Chunk* resolve(PackedEntityInChunk entityInChunk);
+        static PackedEntityInChunk pack(EntityInChunk entityInChunk);
+        /// @brief moves firstFreeBlock past a block found full
+        void skipFullBlock(uint32_t blockIndex);
+        /// @brief the reservation cache of the calling thread
+        ReservationCache& threadReservationCache();
+        /// @brief marks ids as handed out, see isReserved
+        void markReserved(const_span<Entity> entities);
+        /// @brief set keys 0 and 1 are reserved, entity indices are unique keys past them
+        static inline Hash32 getNameKey(uint32_t index) {return index + 2;}
+        void lockNames();
+        void unlockNames();
+        /// @brief drops the name of an entity index if it has one, nameLock must be held
+        void removeName(uint32_t index);
+        /// @brief names or renames an entity index, nameLock must be held
+        void insertName(uint32_t index, const EntityName &name);
     public:
         EntityStore() = default;
-        ~EntityStore() = default;
+        EntityStore(ChunkStore *chunks):chunkStore{chunks}{}
+        ~EntityStore();
         void integrityCheck();
         Chunk* getChunkIfExists(Entity entity);
         void setEntityInChunk(Entity entity, EntityInChunk entityInChunk);
@@ -45,8 +120,24 @@ namespace ECS
         /// @param firstEntityInChunkIndex if you want to fill EntityInChunk value
         void allocateEntities(span<Entity> entities, Chunk *chunk = nullptr, uint32_t firstEntityInChunkIndex = 0);
         void deallocateEntities(span<Entity> entities);
+        /// @brief Allocates entity ids without chunk storage, safe to call from any thread.
+        /// @details small requests are served from a per thread cache of ids allocated ahead.
+        /// reserved entities do not exist until EntityComponentStore::createReservedEntities places them in a chunk.
+        /// @param entities output buffer
+        void reserveEntities(span<Entity> entities);
+        /// @brief Returns true if reserveEntities handed the entity out and it has no chunk storage yet
+        bool isReserved(Entity entity);
+        /// @brief Frees the ids held by the reservation caches that were not handed out yet.
+        /// @details must not run concurrently with reserveEntities
+        void flushReservations();
+        /// @return the name or EntityName::Null(), stays valid while the entity keeps a name, renaming updates it in place
         const EntityName* getEntityName(Entity entity);
-        void setEntityName(Entity entity, EntityName* name = nullptr);
+        /// @details names are kept apart from the data blocks behind their own lock, safe to call from any thread
+        /// @param name nullptr removes the name, names are also dropped with the entity
+        void setEntityName(Entity entity, const EntityName* name = nullptr);
+        /// @brief an entity having the name, Entity() if none does
+        /// @details hashed lookup, if several entities share the name any of them may be returned
+        Entity findEntityByName(const EntityName &name);
     };
 } // namespace ECS
 
@@ -13,11 +13,18 @@ namespace ECS
     struct JobChunkWrapperBase {
         JobHandle schedule(EntityQueryImpl query,ComponentDependencyManager &);
         JobHandle scheduleParallel(EntityQueryImpl query,ComponentDependencyManager &);
+        /// @brief executes the job over every matching chunk on the calling thread
+        void run(EntityQueryImpl query);
+        /// @brief number of chunks to look ahead while iterating, zero disables prefetching
+        /// @details the header of chunk N+distance and the queried columns of chunk N+distance-1 are prefetched
+        static inline void setPrefetchDistance(uint32_t distance) {prefetchDistance = distance;}
+        static inline uint32_t getPrefetchDistance() {return prefetchDistance;}
     private:
         /// @brief JobChunkProducer
         static void execute(void *, uint32_t, uint32_t);
         virtual void execute(const Chunk*, const_span<int32_t>) = 0;
         const EntityQueryData *query = nullptr;
+        static inline uint32_t prefetchDistance = Constants::ChunkPrefetchDistance;
     };
     template<typename IJOB>
     struct JobChunkWrapper : JobChunkWrapperBase {
@@ -2,6 +2,7 @@
 #include "ECS/Base/Chunk.hpp"
 #include "ECS/Base/ChunkListChanges.hpp"
 #include "ECS/EntityComponentStore.hpp"
+#include <algorithm>
 using namespace ECS;
 
 void Archetype::addToChunkList(Chunk* chunk, SharedComponentValues sharedComponentIndices, uint32_t changeVersion, ChunkListChanges& changes) {
@@ -82,17 +83,22 @@ void Archetype::emptySlotTrackingAddChunk(Chunk* chunk){
 Chunk* Archetype::getExistingChunkWithEmptySlots(const SharedComponentValues sharedComponentValues){
     if (numSharedComponents() == 0)
     {
-        if (!chunksWithEmptySlots.empty())
+        // prefer the fullest of the most recent chunks, sparse chunks are left to drain
+        Chunk *result = nullptr;
+        const size_t size = chunksWithEmptySlots.size();
+        const size_t first = size > Constants::FillPolicyScanCount ? size - Constants::FillPolicyScanCount : 0;
+        for (size_t i = size; i > first; i--)
         {
-            Chunk* chunk = chunksWithEmptySlots.back();
-            if(chunk->count >= this->chunkCapacity)
+            Chunk* chunk = chunksWithEmptySlots[i - 1];
+            if(chunk->count >= this->getChunkCapacity(chunk))
                 throw std::runtime_error("getExistingChunkWithEmptySlots(): invalid chunk");
-            return chunk;
+            if (result == nullptr || chunk->count > result->count)
+                result = chunk;
         }
-        return nullptr;
+        return result;
     }
-    // note: will be ChunkIndex.Null if none available.
-    return freeChunksBySharedComponents.tryGet(sharedComponentValues, numSharedComponents());
+    // note: will be nullptr if none available.
+    return freeChunksBySharedComponents.tryGetFullest(sharedComponentValues, numSharedComponents());
 }
 
 
@@ -105,7 +111,7 @@ int32_t Archetype::getIndexInTypeArray(TypeID type) const
     TypeID *types_end = types + this->typeCount;
     for (;types!=types_end;++types){
         if (type == *types)
-            return (int32_t)(types_end - types);
+            return (int32_t)(types - this->_types);
         else if(type < *types)
             return -1;
     }
@@ -119,7 +125,7 @@ int32_t Archetype::getNextIndexInTypeArray(TypeID type, int32_t lastTypeIndexInT
     TypeID *types_end = this->_types + this->typeCount;
     for (;types!=types_end;++types) {
         if (type == *types)
-            return (int32_t)(types_end - types);
+            return (int32_t)(types - this->_types);
         else if(type < *types)
             return -1;
     }
@@ -140,9 +146,11 @@ void Archetype::releaseChunk(Chunk* chunk)
         }
     }
     // this chunk is going away, so it shouldn't be in the empty slot list.
-    if (chunk->count < this->chunkCapacity)
+    if (chunk->count < this->getChunkCapacity(chunk))
         this->emptySlotTrackingRemoveChunk(chunk);
     this->removeFromChunkList(chunk,this->entityComponentStore->chunkListChangesTracker);
+    if (chunk->companion != nullptr)
+        entityComponentStore->chunks.freeChunk(chunk->companion->index);
     entityComponentStore->chunks.freeChunk(chunk->index);
 }
 void Archetype::setChunkCount(Chunk* chunk, uint32_t newCount)
@@ -155,7 +163,7 @@ void Archetype::setChunkCount(Chunk* chunk, uint32_t newCount)
         releaseChunk(chunk);
         return;
     }
-    uint32_t capacity = this->chunkCapacity;
+    uint32_t capacity = this->getChunkCapacity(chunk);
     // Chunk is now full
     if (newCount == capacity)
     {
@@ -171,43 +179,92 @@ void Archetype::setChunkCount(Chunk* chunk, uint32_t newCount)
     }
     chunk->count = newCount;
 }
-void Archetype::initializeComponents(Chunk* chunk, uint32_t dstIndex, uint32_t count) {
-    uint32_t *offsets = this->_offsets;
-    uint16_t *sizeOfs = this->_sizeOfs;
+void Archetype::initializeComponents(Chunk* chunk, uint32_t dstIndex, uint32_t count, const_span<ComponentColumn> skip) {
+    const uint32_t *offsets = this->offsetsOf(chunk);
     TypeID *types = this->_types;
-    TypeManager::DefaultFunction *dCons = this->_dConstructor;
-    uint8_t  *dstBuffer = (uint8_t*)chunk;
     uint32_t  typesCount = this->numNonZeroSizedTypes();
     for (uint32_t t = 1; t != typesCount; t++)
     {
-        uint32_t sizeOf = sizeOfs[t];
         TypeID type = types[t];
-        uint8_t *dst = dstBuffer + (offsets[t] + sizeOf * dstIndex);
-        if(!type.isManagedComponent()){
-            memset(dst, 0, sizeOf*count);
-        }else{
-            TypeManager::DefaultFunction dCon = dCons[t];
-            for (uint32_t i = 0; i != count; i++){
-                dCon(dst);
-                dst += sizeOf;
-            }
+        if(std::any_of(skip.begin(), skip.end(), [type](const ComponentColumn &column){return column.type == type;}))
+            continue;
+        this->initializeColumn(columnChunk(chunk, type) + offsets[t], t, dstIndex, count);
+    }
+}
+void Archetype::initializeColumn(uint8_t *column, uint32_t t, uint32_t dstIndex, uint32_t count) const {
+    const uint32_t sizeOf = this->_sizeOfs[t];
+    const TypeID type = this->_types[t];
+    const void *prototype = this->_prototypes[t];
+    if(type.isAoSoA()){
+        if(prototype)
+            AoSoA::fill(column, dstIndex, count, sizeOf, prototype);
+        else
+            AoSoA::clear(column, dstIndex, count, sizeOf);
+        return;
+    }
+    uint8_t *dst = column + sizeOf * dstIndex;
+    if(type.isManagedComponent()){
+        TypeManager::DefaultFunction dCon = this->_dConstructor[t];
+        for (uint32_t i = 0; i != count; i++){
+            dCon(dst);
+            dst += sizeOf;
         }
+    }else if(prototype){
+        CopyKernels::fill(dst, prototype, count, sizeOf);
+    }else{
+        memset(dst, 0, sizeOf*count);
     }
 }
 uint32_t Archetype::allocateIntoChunk(Chunk* chunk, uint32_t count, uint32_t& outIndex)
 {
     outIndex = chunk->count;
-    uint32_t allocatedCount = std::min(chunkCapacity - outIndex, count);
+    uint32_t allocatedCount = std::min(this->getChunkCapacity(chunk) - outIndex, count);
     setChunkCount(chunk, outIndex + allocatedCount);
     this->entityCount += allocatedCount;
     return allocatedCount;
 }
 uint32_t Archetype::allocate(Chunk* chunk, uint32_t count, Entity *entities)
+{
+    return this->allocate(chunk, count, entities, {}, 0);
+}
+uint32_t Archetype::allocate(Chunk* chunk, uint32_t count, Entity *entities, const_span<ComponentColumn> columns, uint32_t sourceIndex)
 {
     Version globalSystemVersion = entityComponentStore->getGlobalSystemVersion();
     uint32_t allocatedIndex;
     uint32_t allocatedCount = this->allocateIntoChunk(chunk, count, allocatedIndex);
     entityComponentStore->allocateEntities(this, chunk, allocatedIndex, allocatedCount, entities);
+    initializeComponents(chunk, allocatedIndex, allocatedCount, columns);
+
+    const uint32_t *offsets = this->offsetsOf(chunk);
+    for (const ComponentColumn &column:columns)
+    {
+        const int32_t t = this->getIndexInTypeArray(column.type);
+        const uint32_t sizeOf = this->_sizeOfs[t];
+        const uint8_t *src = (const uint8_t*)column.data + (size_t)sourceIndex * sizeOf;
+        uint8_t *dst = columnChunk(chunk, column.type) + offsets[t];
+        if (column.type.isAoSoA()){
+            for (uint32_t i = 0; i < allocatedCount; i++)
+                AoSoA::store(dst, allocatedIndex + i, sizeOf, src + i * sizeOf);
+            continue;
+        }
+        this->_copyKernels[t](dst + sizeOf * allocatedIndex, src, allocatedCount, sizeOf);
+    }
+
+    // Add Entities in Chunk. ChangeVersion:Yes OrderVersion:Yes
+    this->chunks.setOrderVersion(chunk->listIndex, globalSystemVersion);
+    this->chunks.setAllChangeVersion(chunk->listIndex, globalSystemVersion);
+    entityComponentStore->incrementComponentTypeOrderVersion(this);
+
+    return allocatedCount;
+}
+uint32_t Archetype::allocateReserved(Chunk* chunk, uint32_t count, const Entity *entities)
+{
+    Version globalSystemVersion = entityComponentStore->getGlobalSystemVersion();
+    uint32_t allocatedIndex;
+    uint32_t allocatedCount = this->allocateIntoChunk(chunk, count, allocatedIndex);
+    memcpy((Entity*)chunk->buffer + allocatedIndex, entities, allocatedCount * sizeof(Entity));
+    for (uint32_t i = 0; i < allocatedCount; i++)
+        entityComponentStore->setEntityInChunk(entities[i], { chunk, allocatedIndex + i });
     initializeComponents(chunk, allocatedIndex, allocatedCount);
 
     // Add Entities in Chunk. ChangeVersion:Yes OrderVersion:Yes
@@ -217,6 +274,44 @@ uint32_t Archetype::allocate(Chunk* chunk, uint32_t count, Entity *entities)
 
     return allocatedCount;
 }
+uint32_t Archetype::instantiate(Chunk* chunk, uint32_t count, Entity *entities, const Chunk *prototypeChunk, uint32_t prototypeIndex)
+{
+    if(prototypeChunk->archetype != this || chunk->archetype != this)
+        throw std::invalid_argument("instantiate(): the archetypes do not match");
+    Version globalSystemVersion = entityComponentStore->getGlobalSystemVersion();
+    uint32_t allocatedIndex;
+    uint32_t allocatedCount = this->allocateIntoChunk(chunk, count, allocatedIndex);
+    entityComponentStore->allocateEntities(this, chunk, allocatedIndex, allocatedCount, entities);
+
+    const uint32_t *srcOffsets = this->offsetsOf(prototypeChunk);
+    const uint32_t *dstOffsets = this->offsetsOf(chunk);
+    const uint32_t typesCount = this->numNonZeroSizedTypes();
+    for (uint32_t t = 1; t < typesCount && allocatedCount != 0; t++)
+    {
+        const TypeID type = this->_types[t];
+        const uint32_t sizeOf = this->_sizeOfs[t];
+        const uint8_t *src = columnChunk(prototypeChunk, type) + srcOffsets[t];
+        uint8_t *dst = columnChunk(chunk, type) + dstOffsets[t];
+        // a single copy of the prototype then doubling copies of what is already written
+        if (type.isAoSoA()){
+            AoSoA::copy(src, prototypeIndex, dst, allocatedIndex, 1, sizeOf);
+            for (uint32_t written = 1; written < allocatedCount; written *= 2)
+                AoSoA::copy(dst, allocatedIndex, dst, allocatedIndex + written, std::min(written, allocatedCount - written), sizeOf);
+            continue;
+        }
+        dst += sizeOf * allocatedIndex;
+        memcpy(dst, src + sizeOf * prototypeIndex, sizeOf);
+        for (uint32_t written = 1; written < allocatedCount; written *= 2)
+            memcpy(dst + sizeOf * written, dst, sizeOf * std::min(written, allocatedCount - written));
+    }
+
+    // Add Entities in Chunk. ChangeVersion:Yes OrderVersion:Yes
+    this->chunks.setOrderVersion(chunk->listIndex, globalSystemVersion);
+    this->chunks.setAllChangeVersion(chunk->listIndex, globalSystemVersion);
+    entityComponentStore->incrementComponentTypeOrderVersion(this);
+
+    return allocatedCount;
+}
 void Archetype::deallocate(Chunk *chunk)
 {
     if(chunk == nullptr)
@@ -280,20 +375,32 @@ void Archetype::copy(const Chunk *srcChunk, uint32_t srcIndex, const Chunk *dstC
     if(arch != dstChunk->archetype)
         throw std::invalid_argument("copy(): the archetypes do not match");
 
-    uint8_t *srcBuffer = (uint8_t*)srcChunk;
-    uint8_t *dstBuffer = (uint8_t*)dstChunk;
-    uint32_t *offsets = arch->_offsets;
+    // chunks of one archetype may belong to different size classes
+    const uint32_t *srcOffsets = arch->offsetsOf(srcChunk);
+    const uint32_t *dstOffsets = arch->offsetsOf(dstChunk);
     uint16_t *sizeOfs = arch->_sizeOfs;
+    const TypeID *types = arch->_types;
+    const CopyKernel *copyKernels = arch->_copyKernels;
+    const TypeManager::RelocateFunction *relocators = arch->_relocators;
     uint32_t typesCount = arch->typeCount;
 
     for (uint32_t t = 0; t < typesCount; t++)
     {
-        const uint32_t offset = offsets[t];
         const uint32_t sizeOf = sizeOfs[t];
-        void *src = srcBuffer + (offset + sizeOf * srcIndex);
-        void *dst = dstBuffer + (offset + sizeOf * dstIndex);
+        uint8_t *srcBuffer = columnChunk(srcChunk, types[t]);
+        uint8_t *dstBuffer = columnChunk(dstChunk, types[t]);
+        if (types[t].isAoSoA()){
+            AoSoA::copy(srcBuffer + srcOffsets[t], srcIndex, dstBuffer + dstOffsets[t], dstIndex, count, sizeOf);
+            continue;
+        }
+        const uint8_t *src = srcBuffer + (srcOffsets[t] + sizeOf * srcIndex);
+        uint8_t *dst = dstBuffer + (dstOffsets[t] + sizeOf * dstIndex);
 
-        memcpy(dst, src, sizeOf * count);
+        // the source slots are abandoned, non trivial types are moved
+        if (relocators[t])
+            relocators[t](dst, (void*)src, count);
+        else
+            copyKernels[t](dst, src, count, sizeOf);
     }
 }
 void Archetype::copyComponents(const Chunk *srcChunk, uint32_t srcIndex, const Chunk *dstChunk, uint32_t dstIndex, uint32_t count, uint32_t dstGlobalSystemVersion)
@@ -302,21 +409,27 @@ void Archetype::copyComponents(const Chunk *srcChunk, uint32_t srcIndex, const C
         throw std::invalid_argument("copyComponents(): incompatible archetypes layout");
 
     Archetype *dstArch   = dstChunk->archetype;
-    uint8_t  *srcBuffer  = (uint8_t*)srcChunk;
-    uint8_t  *dstBuffer  = (uint8_t*)dstChunk;
-    uint32_t *offsets    = dstArch->_offsets;
+    const uint32_t *srcOffsets = srcChunk->archetype->offsetsOf(srcChunk);
+    const uint32_t *dstOffsets = dstArch->offsetsOf(dstChunk);
     uint16_t *sizeOfs    = dstArch->_sizeOfs;
+    const CopyKernel *copyKernels = dstArch->_copyKernels;
+    const TypeID *types  = dstArch->_types;
     uint32_t  typesCount = dstArch->typeCount;
     int32_t dstChunkListIndex = dstChunk->listIndex;
 
     for (uint32_t t = 1; t < typesCount; t++) // Only copy component data, not Entity
     {
-        const uint32_t offset = offsets[t];
         const uint32_t sizeOf = sizeOfs[t];
-        void *src = srcBuffer + (offset + sizeOf * srcIndex);
-        void *dst = dstBuffer + (offset + sizeOf * dstIndex);
+        uint8_t *srcBuffer = columnChunk(srcChunk, types[t]);
+        uint8_t *dstBuffer = columnChunk(dstChunk, types[t]);
         dstArch->chunks.setChangeVersion(t, dstChunkListIndex, dstGlobalSystemVersion);
-        memcpy(dst, src, sizeOf * count);
+        if (types[t].isAoSoA()){
+            AoSoA::copy(srcBuffer + srcOffsets[t], srcIndex, dstBuffer + dstOffsets[t], dstIndex, count, sizeOf);
+            continue;
+        }
+        const uint8_t *src = srcBuffer + (srcOffsets[t] + sizeOf * srcIndex);
+        uint8_t *dst = dstBuffer + (dstOffsets[t] + sizeOf * dstIndex);
+        copyKernels[t](dst, src, count, sizeOf);
     }
 }
 bool Archetype::areLayoutCompatible(Archetype* a, Archetype* b)
@@ -326,8 +439,9 @@ bool Archetype::areLayoutCompatible(Archetype* a, Archetype* b)
     if(a != b)
     {
         // quick check
-        if(a->chunkCapacity != b->chunkCapacity)
-            return false;
+        for(uint32_t c = 0; c < Chunk::SizeClassCount; ++c)
+            if(a->chunkCapacity[c] != b->chunkCapacity[c])
+                return false;
         uint32_t typeCount = a->numNonZeroSizedTypes();
         if(typeCount != b->numNonZeroSizedTypes())
             return false;
@@ -382,10 +496,12 @@ const uint8_t* Archetype::getComponentDataWithTypeRO(const Chunk *chunk, uint32_
         throw std::invalid_argument("getComponentDataWithTypeRO(): type not fount");
     if(chunk->count <= baseEntityIndex)
         throw std::out_of_range("getComponentDataWithTypeRO(): invalid entity index");
-    uint32_t offset = this->_offsets[indexInTypeArray];
+    uint32_t offset = this->offsetsOf(chunk)[indexInTypeArray];
     uint32_t sizeOf = this->_sizeOfs[indexInTypeArray];
+    if(unlikely(this->_types[indexInTypeArray].isAoSoA() && baseEntityIndex % AoSoA::BlockSize != 0))
+        throw std::invalid_argument("getComponentDataWithTypeRO(): AoSoA component, index must start a block");
 
-    return (uint8_t*)chunk + (offset + sizeOf * baseEntityIndex);
+    return columnChunk(chunk, this->_types[indexInTypeArray]) + (offset + sizeOf * baseEntityIndex);
 }
 const uint8_t* Archetype::getComponentDataRO(const Chunk *chunk, uint32_t baseEntityIndex, uint32_t indexInTypeArray) const
 {
@@ -393,10 +509,12 @@ const uint8_t* Archetype::getComponentDataRO(const Chunk *chunk, uint32_t baseEn
         throw std::invalid_argument("getComponentDataWithTypeRO(): type not fount");
     if(chunk->count <= baseEntityIndex)
         throw std::out_of_range("getComponentDataWithTypeRO(): invalid entity index");
-    uint32_t offset = this->_offsets[indexInTypeArray];
+    uint32_t offset = this->offsetsOf(chunk)[indexInTypeArray];
     uint32_t sizeOf = this->_sizeOfs[indexInTypeArray];
+    if(unlikely(this->_types[indexInTypeArray].isAoSoA() && baseEntityIndex % AoSoA::BlockSize != 0))
+        throw std::invalid_argument("getComponentDataRO(): AoSoA component, index must start a block");
 
-    return (uint8_t*)chunk + (offset + sizeOf * baseEntityIndex);
+    return columnChunk(chunk, this->_types[indexInTypeArray]) + (offset + sizeOf * baseEntityIndex);
 }
 uint8_t* Archetype::getComponentDataWithTypeRW(const Chunk *chunk, uint32_t baseEntityIndex, TypeID type, Version globalSystemVersion)
 {
@@ -405,13 +523,15 @@ uint8_t* Archetype::getComponentDataWithTypeRW(const Chunk *chunk, uint32_t base
         throw std::invalid_argument("getComponentDataWithTypeRO(): type not fount");
     if(chunk->count <= baseEntityIndex)
         throw std::out_of_range("getComponentDataWithTypeRO(): invalid entity index");
-    uint32_t offset = this->_offsets[indexInTypeArray];
+    uint32_t offset = this->offsetsOf(chunk)[indexInTypeArray];
     uint32_t sizeOf = this->_sizeOfs[indexInTypeArray];
+    if(unlikely(this->_types[indexInTypeArray].isAoSoA() && baseEntityIndex % AoSoA::BlockSize != 0))
+        throw std::invalid_argument("getComponentDataWithTypeRW(): AoSoA component, index must start a block");
 
     // Write Component to Chunk. ChangeVersion:Yes OrderVersion:No
     this->chunks.setChangeVersion(indexInTypeArray, chunk->listIndex, globalSystemVersion);
 
-    return (uint8_t*)chunk + (offset + sizeOf * baseEntityIndex);
+    return columnChunk(chunk, this->_types[indexInTypeArray]) + (offset + sizeOf * baseEntityIndex);
 }
 uint8_t* Archetype::getComponentDataRW(const Chunk *chunk, uint32_t baseEntityIndex, uint32_t indexInTypeArray, Version globalSystemVersion)
 {
@@ -419,13 +539,15 @@ uint8_t* Archetype::getComponentDataRW(const Chunk *chunk, uint32_t baseEntityIn
         throw std::invalid_argument("getComponentDataWithTypeRO(): type not fount");
     if(chunk->count <= baseEntityIndex)
         throw std::out_of_range("getComponentDataWithTypeRO(): invalid entity index");
-    uint32_t offset = this->_offsets[indexInTypeArray];
+    uint32_t offset = this->offsetsOf(chunk)[indexInTypeArray];
     uint32_t sizeOf = this->_sizeOfs[indexInTypeArray];
+    if(unlikely(this->_types[indexInTypeArray].isAoSoA() && baseEntityIndex % AoSoA::BlockSize != 0))
+        throw std::invalid_argument("getComponentDataRW(): AoSoA component, index must start a block");
 
     // Write Component to Chunk. ChangeVersion:Yes OrderVersion:No
     this->chunks.setChangeVersion(indexInTypeArray, chunk->listIndex, globalSystemVersion);
 
-    return (uint8_t*)chunk + (offset + sizeOf * baseEntityIndex);
+    return columnChunk(chunk, this->_types[indexInTypeArray]) + (offset + sizeOf * baseEntityIndex);
 }
 void Archetype::addEmptyChunk(Chunk *chunk, const SharedComponentValues sharedComponentValues)
 {
@@ -487,80 +609,99 @@ void Archetype::clone(Archetype *srcArchetype, EntityBatchInChunk srcBatch, Arch
     const SharedComponentValues dstSharedComponentValues = dstArchetype->chunks.getSharedComponentValues(dstChunk->listIndex);
     entityComponentStore->incrementComponentOrderVersion(dstArchetype, dstSharedComponentValues);
 }
-void Archetype::convert(Archetype *srcArchetype, Chunk *srcChunk, uint32_t srcIndex, Archetype *dstArchetype, Chunk *dstChunk, uint32_t dstIndex, uint32_t count)
+ArchetypeConversion Archetype::getConversion(Archetype *dstArchetype)
 {
-    if(srcChunk == dstChunk)
-        throw std::invalid_argument("convert(): logic error, same chunk conversion");
-    if(srcArchetype == nullptr || dstArchetype == nullptr || srcChunk == nullptr || dstArchetype == nullptr)
-        throw std::invalid_argument("convert(): nullptr");
+    for (const ArchetypeConversion &conversion:this->conversions)
+        if (conversion.archetype == dstArchetype)
+            return conversion;
 
-    // Process non-zero-sized types
-    int32_t srcI = srcArchetype->numNonZeroSizedTypes() - 1;
-    int32_t dstI = dstArchetype->numNonZeroSizedTypes() - 1;
-    uint32_t srcFirstManagedComponent = srcArchetype->firstManagedComponent;
+    ArchetypeConversion conversion;
+    conversion.archetype = dstArchetype;
+    conversion.columnsBegin = (uint32_t)this->conversionColumns.size();
+    conversion.columnCount = (uint16_t)dstArchetype->numNonZeroSizedTypes();
+    conversion.deallocateCount = 0;
 
-    const TypeManager::DefaultFunction *srcDDes = srcArchetype->_dDestructor;
-    const TypeID *srcTypes = srcArchetype->_types;
+    int32_t srcI = this->numNonZeroSizedTypes() - 1;
+    int32_t dstI = dstArchetype->numNonZeroSizedTypes() - 1;
+    const TypeID *srcTypes = this->_types;
     const TypeID *dstTypes = dstArchetype->_types;
-    const uint16_t *srcSizeOfs = srcArchetype->_sizeOfs;
-    const uint16_t *dstSizeOfs = dstArchetype->_sizeOfs;
-    const uint32_t *srcOffsets = srcArchetype->_offsets;
-    const uint32_t *dstOffsets = dstArchetype->_offsets;
-    uint8_t *srcChunkBuffer = (uint8_t*)srcChunk;
-    uint8_t *dstChunkBuffer = (uint8_t*)dstChunk;
-
-    uint32_t sourceTypesToDealloc[srcI + 1];
-    uint32_t sourceTypesToDeallocCount = 0;
+    int16_t columns[conversion.columnCount];
+    int16_t deallocate[srcI + 1];
 
+    // zipper both sorted type arrays backwards
     while (dstI >= 0){
         TypeID srcType = srcTypes[srcI];
         TypeID dstType = dstTypes[dstI];
-
         if (srcType > dstType){
-            //Type in source is not moved so deallocate it
-            sourceTypesToDealloc[sourceTypesToDeallocCount++] = srcI;
+            //Type in source is not moved so deallocate it, trivially destructible types need nothing
+            if (this->_destructors[srcI] != nullptr)
+                deallocate[conversion.deallocateCount++] = (int16_t)srcI;
             --srcI;
             continue;
         }
+        if (srcType == dstType)
+            columns[dstI] = (int16_t)srcI--;
+        else
+            columns[dstI] = -1;
+        --dstI;
+    }
+    this->conversionColumns.insert(this->conversionColumns.end(), columns, columns + conversion.columnCount);
+    this->conversionColumns.insert(this->conversionColumns.end(), deallocate, deallocate + conversion.deallocateCount);
+    this->conversions.push_back(conversion);
+    return conversion;
+}
+void Archetype::convert(Archetype *srcArchetype, Chunk *srcChunk, uint32_t srcIndex, Archetype *dstArchetype, Chunk *dstChunk, uint32_t dstIndex, uint32_t count)
+{
+    if(srcChunk == dstChunk)
+        throw std::invalid_argument("convert(): logic error, same chunk conversion");
+    if(srcArchetype == nullptr || dstArchetype == nullptr || srcChunk == nullptr || dstArchetype == nullptr)
+        throw std::invalid_argument("convert(): nullptr");
 
-        uint32_t srcStride = srcSizeOfs[srcI];
-        uint32_t dstStride = dstSizeOfs[dstI];
-        uint8_t *src = srcChunkBuffer + srcOffsets[srcI] + srcIndex * srcStride;
-        uint8_t *dst = dstChunkBuffer + dstOffsets[dstI] + dstIndex * dstStride;
+    // Process non-zero-sized types
+    const ArchetypeConversion conversion = srcArchetype->getConversion(dstArchetype);
+    const int16_t *columns = srcArchetype->conversionColumns.data() + conversion.columnsBegin;
 
-        if (srcType == dstType){
-            // Component exists in both src and dst archetypes; copy current value.
-            memcpy(dst, src, count * srcStride);
-            --srcI;
-            --dstI;
-        }else{
-            // Component is in dst but not source. Clear values to default.
-            memset(dst, 0, count * dstStride);
-            --dstI;
+    const TypeManager::DestructFunction *srcDestructors = srcArchetype->_destructors;
+    const TypeManager::RelocateFunction *dstRelocators = dstArchetype->_relocators;
+    const TypeID *srcTypes = srcArchetype->_types;
+    const TypeID *dstTypes = dstArchetype->_types;
+    const uint16_t *srcSizeOfs = srcArchetype->_sizeOfs;
+    const uint16_t *dstSizeOfs = dstArchetype->_sizeOfs;
+    const CopyKernel *dstCopyKernels = dstArchetype->_copyKernels;
+    const uint32_t *srcOffsets = srcArchetype->offsetsOf(srcChunk);
+    const uint32_t *dstOffsets = dstArchetype->offsetsOf(dstChunk);
+
+    for (uint32_t dstI = 0; dstI < conversion.columnCount; dstI++){
+        const int32_t srcI = columns[dstI];
+        const TypeID dstType = dstTypes[dstI];
+        const uint32_t stride = dstSizeOfs[dstI];
+        uint8_t *dstColumn = columnChunk(dstChunk, dstType) + dstOffsets[dstI];
+
+        if (srcI < 0){
+            // Component is in dst but not source. Initialize values to default.
+            dstArchetype->initializeColumn(dstColumn, dstI, dstIndex, count);
+            continue;
         }
+        // Component exists in both src and dst archetypes; copy current value.
+        // same type means same layout on both sides
+        const uint8_t *srcColumn = columnChunk(srcChunk, dstType) + srcOffsets[srcI];
+        if (dstType.isAoSoA())
+            AoSoA::copy(srcColumn, srcIndex, dstColumn, dstIndex, count, stride);
+        else if (dstRelocators[dstI])
+            dstRelocators[dstI](dstColumn + dstIndex * stride, (void*)(srcColumn + srcIndex * stride), count);
+        // large batches come from moving whole chunks, the source is released right after
+        else if (count * stride >= CopyKernels::StreamingThreshold)
+            CopyKernels::copyStreaming(dstColumn + dstIndex * stride, srcColumn + srcIndex * stride, count * stride);
+        else
+            dstCopyKernels[dstI](dstColumn + dstIndex * stride, srcColumn + srcIndex * stride, count, stride);
     }
 
-    if (sourceTypesToDeallocCount == 0)
-        return;
-
-    sourceTypesToDealloc[sourceTypesToDeallocCount] = 0;
-
-    uint32_t iDealloc = 0;
-    if (sourceTypesToDealloc[iDealloc] >= srcFirstManagedComponent)
+    const int16_t *deallocate = columns + conversion.columnCount;
+    for (uint32_t d = 0; d < conversion.deallocateCount; d++)
     {
-        do
-        {
-            srcI = sourceTypesToDealloc[iDealloc];
-            uint32_t srcStride = srcSizeOfs[srcI];
-            TypeManager::DefaultFunction dFunc = srcDDes[srcI];
-            uint8_t *src = srcChunkBuffer + srcOffsets[srcI] + srcIndex * srcStride;
-            for (uint32_t i = 0; i < count; i++)
-            {
-                dFunc(src);
-                src += srcStride;
-            }
-        }
-        while ((sourceTypesToDealloc[++iDealloc] >= srcFirstManagedComponent));
+        const int32_t srcI = deallocate[d];
+        uint32_t srcStride = srcSizeOfs[srcI];
+        srcDestructors[srcI](columnChunk(srcChunk, srcTypes[srcI]) + srcOffsets[srcI] + srcIndex * srcStride, count);
     }
 }
 void Archetype::cloneChangeVersions(Archetype* srcArchetype, int32_t chunkIndexInSrcArchetype, Archetype* dstArchetype, int32_t chunkIndexInDstArchetype, bool dstValidExistingVersions)
@@ -611,8 +752,8 @@ void Archetype::cloneChangeVersions(Archetype* srcArchetype, int32_t chunkIndexI
 void Archetype::changeArchetypeInPlace(Archetype* srcArchetype, Chunk *srcChunk, Archetype* dstArchetype, const SharedComponentValues dstSharedComponentValues)
 {
     EntityComponentStore *entityComponentStore = dstArchetype->entityComponentStore;
-    if(areLayoutCompatible(srcArchetype, dstArchetype))
-        throw std::invalid_argument("invalid arguement");
+    if(!areLayoutCompatible(srcArchetype, dstArchetype))
+        throw std::invalid_argument("changeArchetypeInPlace(): incompatible archetypes layout");
 
     const SharedComponentValues srcSharedComponentValues = srcArchetype->chunks.getSharedComponentValues(srcChunk->listIndex);
 
@@ -663,7 +804,7 @@ void Archetype::changeArchetypeInPlace(Archetype* srcArchetype, Chunk *srcChunk,
     }
 
     uint32_t count = srcChunk->count;
-    bool hasEmptySlots = count < srcArchetype->chunkCapacity;
+    bool hasEmptySlots = count < srcArchetype->getChunkCapacity(srcChunk);
 
     if (hasEmptySlots)
         srcArchetype->emptySlotTrackingRemoveChunk(srcChunk);
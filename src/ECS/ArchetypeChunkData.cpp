@@ -58,6 +58,13 @@ void ArchetypeChunkData::setSharedComponentValue(uint32_t shared_component_index
     _SharedComponentValue[shared_component_index_in_archtype * _capacity + index] = value;
 }
 
+void ArchetypeChunkData::setEntityCapacity(uint32_t entityCapacity) {
+    if(this->buck.get() != nullptr)
+        throw std::logic_error("setEntityCapacity(): chunk data already allocated");
+    if(entityCapacity < 1 || entityCapacity > Constants::MaximumEntitiesPerChunk)
+        throw std::invalid_argument("setEntityCapacity(): invalid capacity");
+    this->enabledWordCount = (entityCapacity + 63) / 64;
+}
 void ArchetypeChunkData::popBack() {
     if(this->_count < 1)
         throw std::out_of_range("popBack(): empty array");
@@ -91,14 +98,14 @@ void ArchetypeChunkData::grow(uint32_t new_capacity) {
     const uint32_t nextChunkIndexSize            = new_capacity * (uint32_t)sizeof(Chunk*);
     const uint32_t nextChangeVersionSize         = new_capacity * (uint32_t)sizeof(Version) * this->componentCount;
     const uint32_t nextSharedComponentValuesSize = new_capacity * (uint32_t)sizeof(SharedComponentIndex) * this->sharedComponentCount;
-    const uint32_t nextComponentEnabledBitsSize  = new_capacity * (uint32_t)sizeof(EnabledBitset) * this->sharedComponentCount;
+    const uint32_t nextComponentEnabledBitsSize  = new_capacity * (uint32_t)sizeof(uint64_t) * this->enabledWordCount * this->componentCount;
     const uint32_t new_v_size = nextChunkIndexSize + nextChangeVersionSize + nextSharedComponentValuesSize + nextComponentEnabledBitsSize;
 
     align_ptr<uint8_t[]> new_data = make_align<uint8_t[]>(new_v_size);
     Chunk** nextChunk;
     Version* nextChangeVersion;
     SharedComponentIndex* nextSharedComponentValue;
-    EnabledBitset* nextComponentEnabledBit;
+    uint64_t* nextComponentEnabledBit;
     void *nextBuckEnd;
     {
         uint8_t* nextBufferPtr   = new_data.get();
@@ -108,7 +115,7 @@ void ArchetypeChunkData::grow(uint32_t new_capacity) {
         nextBufferPtr += nextChangeVersionSize;
         nextSharedComponentValue = (SharedComponentIndex*)nextBufferPtr;
         nextBufferPtr += nextSharedComponentValuesSize;
-        nextComponentEnabledBit  = (EnabledBitset*)nextBufferPtr;
+        nextComponentEnabledBit  = (uint64_t*)nextBufferPtr;
         nextBufferPtr += nextComponentEnabledBitsSize;
         nextBuckEnd = nextBufferPtr;
     }
@@ -116,7 +123,7 @@ void ArchetypeChunkData::grow(uint32_t new_capacity) {
     if(this->buck.get() != nullptr) {
         memcpy(nextChunk,
             this->_Chunk,
-            this->_count * sizeof(uint32_t)
+            this->_count * sizeof(Chunk*)
         );
         for(uint32_t i = 0; i < componentCount; ++i)
             memcpy(nextChangeVersion + i * new_capacity,
@@ -130,7 +137,7 @@ void ArchetypeChunkData::grow(uint32_t new_capacity) {
             );
         memcpy(nextComponentEnabledBit,
             this->_ComponentEnabledBit,
-            this->_count * sizeof(EnabledBitset)
+            this->_count * this->componentCount * this->enabledWordCount * sizeof(uint64_t)
         );
     }
 
@@ -158,5 +165,6 @@ void ArchetypeChunkData::removeAtSwapBack(uint32_t index) {
         _ChangeVersion[(i * _capacity) + index] = _ChangeVersion[(i * _capacity) + _count];
     for (uint32_t i = 0; i < sharedComponentCount; i++)
         _SharedComponentValue[(i * _capacity) + index] = _SharedComponentValue[(i * _capacity) + _count];
-    memcpy(_ComponentEnabledBit+(componentCount*index), _ComponentEnabledBit+(componentCount*_count), componentCount*sizeof(EnabledBitset));
+    const uint32_t enabledWords = componentCount * enabledWordCount;
+    memcpy(_ComponentEnabledBit+(enabledWords*index), _ComponentEnabledBit+(enabledWords*_count), enabledWords*sizeof(uint64_t));
 }
@@ -139,6 +139,43 @@ Chunk* ChunkListMap::tryGet(const SharedComponentValues sharedComponentValues, u
             return nullptr;
     }
 }
+Chunk* ChunkListMap::tryGetFullest(const SharedComponentValues sharedComponentValues, uint32_t numSharedComponents, const Chunk *exclude) const {
+    uint32_t desiredHash = getHashCode(sharedComponentValues, numSharedComponents);
+    uint32_t offset = desiredHash & hashMask();
+    Chunk *result = nullptr;
+    for (uint32_t attempts = 0; attempts < capacity(); ++attempts)
+    {
+        uint32_t hash = hashes[offset];
+        if (hash == 0)
+            break;
+        if (hash == desiredHash)
+        {
+            Chunk* chunk = chunks[offset];
+            if(chunk == nullptr)
+                throw std::runtime_error("tryGetFullest(): invalid chunk");
+            if (chunk != exclude && (result == nullptr || chunk->count > result->count))
+            {
+                SharedComponentValues components = this->archetype->chunks.getSharedComponentValues(chunk->listIndex);
+                if (components.equalTo(sharedComponentValues,numSharedComponents))
+                    result = chunk;
+            }
+        }
+        offset = (offset + 1) & hashMask();
+    }
+    return result;
+}
+Chunk* ChunkListMap::getSparsest() const {
+    Chunk *result = nullptr;
+    for (uint32_t offset = 0; offset < capacity(); ++offset)
+    {
+        uint32_t hash = hashes[offset];
+        if (hash == 0 || hash == _SkipCode)
+            continue;
+        if (result == nullptr || chunks[offset]->count < result->count)
+            result = chunks[offset];
+    }
+    return result;
+}
 bool ChunkListMap::contains(Chunk* chunk) const {
     int32_t offset = chunk->listWithEmptySlotsIndex;
     return 0 <= offset && (uint32_t)offset < _capacity && chunks[offset] == chunk;
@@ -1,65 +1,496 @@
 #include "ECS/ChunkStore.hpp"
 #include <memory>
+#include <algorithm>
+#include <stdexcept>
 #include "cutil/span.hpp"
+#if DOE_WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <sched.h>
+#include <stdio.h>
+#endif
 using namespace ECS;
 
-ChunkStore::~ChunkStore(){
-    uint32_t bitmask;
-    uint32_t s_index = 0;
-    uint32_t b_index = 0;
-    for(;b_index < ChunkBunchCount;b_index++){
-        bitmask = bitmasks[b_index];
-        if(bitmask == 0)
-            continue;
-        for(;s_index<BitmaskSize;s_index++)
-            if ((bitmask & (1<<s_index))){
-                Chunk* v = chunks[b_index * 32 + s_index];
-                if(v)
-                    allocator<Chunk>().deallocate(v,1);
+#pragma region NUMA
+namespace {
+    struct NodeTopology {
+        /// @brief number of nodes reported by the OS, capped to Constants::MaximumNodeCount
+        uint32_t hardwareCount = 1;
+        /// @brief node of each CPU
+        std::vector<uint8_t> cpuNodes;
+    };
+    NodeTopology detectTopology() {
+        NodeTopology topology;
+    #if DOE_WIN32
+        ULONG highest = 0;
+        if(GetNumaHighestNodeNumber(&highest))
+            topology.hardwareCount = std::min<uint32_t>((uint32_t)highest + 1, Constants::MaximumNodeCount);
+        const DWORD cpuCount = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+        topology.cpuNodes.assign(cpuCount, 0);
+        for(DWORD cpu = 0;cpu < cpuCount && cpu <= UCHAR_MAX;cpu++){
+            UCHAR node = 0;
+            if(GetNumaProcessorNode((UCHAR)cpu, &node) && node != UCHAR_MAX)
+                topology.cpuNodes[cpu] = (uint8_t)std::min<uint32_t>(node, topology.hardwareCount - 1);
+        }
+    #else
+        // MAGIC NUMBER, highest node id looked up in sysfs
+        for(uint32_t node = 0;node < 64;node++){
+            char path[64];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+            FILE *file = fopen(path, "r");
+            if(file == nullptr)
+                continue;
+            const uint32_t pool = std::min(node, Constants::MaximumNodeCount - 1);
+            topology.hardwareCount = std::max(topology.hardwareCount, pool + 1);
+            // format: "0-3,8,10-11"
+            unsigned first, last;
+            while(fscanf(file, "%u", &first) == 1){
+                last = first;
+                int separator = fgetc(file);
+                if(separator == '-'){
+                    if(fscanf(file, "%u", &last) != 1)
+                        break;
+                    separator = fgetc(file);
+                }
+                if(topology.cpuNodes.size() <= last)
+                    topology.cpuNodes.resize(last + 1, 0);
+                for(unsigned cpu = first;cpu <= last;cpu++)
+                    topology.cpuNodes[cpu] = (uint8_t)pool;
+                if(separator != ',')
+                    break;
             }
+            fclose(file);
+        }
+    #endif
+        return topology;
+    }
+    const NodeTopology& getTopology() {
+        static const NodeTopology topology = detectTopology();
+        return topology;
+    }
+    std::atomic<uint32_t> configuredNodeCount{0};
+    thread_local int32_t threadNode = -1;
+    /// @brief memory binding and thread pinning only make sense on the real topology
+    bool isRealTopology() {
+        return getTopology().hardwareCount > 1 && ChunkStore::getNodeCount() == getTopology().hardwareCount;
+    }
+}
+void ChunkStore::setNodeCount(uint32_t count) {
+    configuredNodeCount.store(std::min(count, Constants::MaximumNodeCount), std::memory_order_release);
+}
+uint32_t ChunkStore::getNodeCount() {
+    const uint32_t count = configuredNodeCount.load(std::memory_order_acquire);
+    return count ? count : getTopology().hardwareCount;
+}
+void ChunkStore::setThreadNode(uint32_t node) {
+    if(node >= Constants::MaximumNodeCount)
+        throw std::invalid_argument("setThreadNode(): invalid node");
+    threadNode = (int32_t)node;
+    if(!isRealTopology())
+        return;
+    const std::vector<uint8_t> &cpuNodes = getTopology().cpuNodes;
+#if DOE_WIN32
+    DWORD_PTR mask = 0;
+    for(size_t cpu = 0;cpu < cpuNodes.size() && cpu < sizeof(mask) * 8;cpu++)
+        if(cpuNodes[cpu] == node)
+            mask |= (DWORD_PTR)1 << cpu;
+    if(mask)
+        SetThreadAffinityMask(GetCurrentThread(), mask);
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(size_t cpu = 0;cpu < cpuNodes.size() && cpu < CPU_SETSIZE;cpu++)
+        if(cpuNodes[cpu] == node)
+            CPU_SET(cpu, &set);
+    if(CPU_COUNT(&set))
+        sched_setaffinity(0, sizeof(set), &set);
+#endif
+}
+uint32_t ChunkStore::getThreadNode() {
+    const uint32_t count = getNodeCount();
+    if(threadNode >= 0)
+        return (uint32_t)threadNode % count;
+    if(!isRealTopology())
+        return 0;
+#if DOE_WIN32
+    const uint32_t cpu = (uint32_t)GetCurrentProcessorNumber();
+#else
+    const int result = sched_getcpu();
+    if(result < 0)
+        return 0;
+    const uint32_t cpu = (uint32_t)result;
+#endif
+    const std::vector<uint8_t> &cpuNodes = getTopology().cpuNodes;
+    return cpu < cpuNodes.size() ? cpuNodes[cpu] : 0;
+}
+#pragma endregion NUMA
+
+#pragma region Slab
+void ChunkStore::lockPool() {
+    uint32_t expected = 0;
+    while(!poolLock.compare_exchange_weak(expected, 1, std::memory_order_acquire)){
+        expected = 0;
+        while(poolLock.load(std::memory_order_relaxed) != 0)
+            ;
+    }
+}
+void ChunkStore::unlockPool() {
+    poolLock.store(0, std::memory_order_release);
+}
+ChunkSlab* ChunkStore::mapSlab(uint8_t sizeClass, uint8_t node) {
+    // everything that may throw happens before the mapping, so a failure cannot leak it
+    std::unique_ptr<ChunkSlab> slab = std::make_unique<ChunkSlab>();
+    if(this->slabs.size() == this->slabs.capacity())
+        this->slabs.reserve(this->slabs.size() * 2 + 1);
+    uint8_t *memory = nullptr;
+    const bool bind = isRealTopology();
+#if DOE_WIN32
+    if(bind)
+        memory = (uint8_t*)VirtualAllocExNuma(GetCurrentProcess(), nullptr, SlabSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node);
+    else
+        memory = (uint8_t*)VirtualAlloc(nullptr, SlabSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if(memory == nullptr)
+        throw std::bad_alloc();
+#else
+    #if defined(MAP_HUGETLB)
+    if(this->hugePages){
+        void *p = mmap(nullptr, SlabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(p != MAP_FAILED)
+            memory = (uint8_t*)p;
+    }
+    #endif
+    if(memory == nullptr){
+        // over-map to get a slab aligned address, transparent huge pages only back aligned ranges
+        void *p = mmap(nullptr, SlabSize * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(p == MAP_FAILED)
+            throw std::bad_alloc();
+        uint8_t *raw = (uint8_t*)p;
+        memory = (uint8_t*)(((uintptr_t)raw + SlabSize - 1) & ~(uintptr_t)(SlabSize - 1));
+        const size_t head = (size_t)(memory - raw);
+        if(head)
+            munmap(raw, head);
+        if(SlabSize - head)
+            munmap(memory + SlabSize, SlabSize - head);
+    #if defined(MADV_HUGEPAGE)
+        if(this->hugePages)
+            madvise(memory, SlabSize, MADV_HUGEPAGE);
+    #endif
+    }
+    #if defined(SYS_mbind)
+    if(bind){
+        // MAGIC NUMBER, MPOL_PREFERRED: falls back to other nodes instead of failing the fault
+        const unsigned long nodeMask = 1UL << node;
+        syscall(SYS_mbind, memory, (unsigned long)SlabSize, 1, &nodeMask, (unsigned long)sizeof(nodeMask) * 8, 0);
+    }
+    #endif
+#endif
+    slab->memory = memory;
+    slab->slabIndex = (uint32_t)this->slabs.size();
+    slab->sizeClass = sizeClass;
+    slab->node = node;
+    this->slabs.push_back(slab.get());
+    this->freeMemory += SlabSize;
+    return slab.release();
+}
+void ChunkStore::unmapSlab(ChunkSlab *slab) {
+    ChunkSlab *last = this->slabs.back();
+    this->slabs[slab->slabIndex] = last;
+    last->slabIndex = slab->slabIndex;
+    this->slabs.pop_back();
+    this->freeMemory -= (size_t)(getChunksPerSlab(slab->sizeClass) - slab->usedCount) * Chunk::getMemorySize(slab->sizeClass);
+#if DOE_WIN32
+    VirtualFree(slab->memory, 0, MEM_RELEASE);
+#else
+    munmap(slab->memory, SlabSize);
+#endif
+    delete slab;
+}
+void ChunkStore::linkPartialSlab(ChunkSlab *slab) {
+    ChunkSlab *&head = this->partialSlabs[slab->node][slab->sizeClass];
+    slab->prev = nullptr;
+    slab->next = head;
+    if(head)
+        head->prev = slab;
+    head = slab;
+}
+void ChunkStore::unlinkPartialSlab(ChunkSlab *slab) {
+    if(slab->prev)
+        slab->prev->next = slab->next;
+    else
+        this->partialSlabs[slab->node][slab->sizeClass] = slab->next;
+    if(slab->next)
+        slab->next->prev = slab->prev;
+    slab->prev = slab->next = nullptr;
+}
+Chunk* ChunkStore::takeChunk(uint8_t sizeClass, uint8_t node) {
+    const uint32_t memorySize = Chunk::getMemorySize(sizeClass);
+    lockPool();
+    ChunkSlab *slab = this->partialSlabs[node][sizeClass];
+    try {
+        if(slab == nullptr){
+            slab = mapSlab(sizeClass, node);
+            linkPartialSlab(slab);
+        }
+    } catch(...) {
+        unlockPool();
+        throw;
+    }
+    Chunk *chunk;
+    if(slab->freeList){
+        chunk = slab->freeList;
+        slab->freeList = *(Chunk**)chunk->buffer;
+    } else {
+        chunk = (Chunk*)(slab->memory + (size_t)slab->carvedCount * memorySize);
+        slab->carvedCount++;
+    }
+    slab->usedCount++;
+    this->freeMemory -= memorySize;
+    if(slab->usedCount == getChunksPerSlab(sizeClass))
+        unlinkPartialSlab(slab);
+    unlockPool();
+    chunk->slab = slab;
+    chunk->sizeClass = sizeClass;
+    chunk->node = node;
+    return chunk;
+}
+void ChunkStore::giveChunk(Chunk *chunk) {
+    ChunkSlab *slab = chunk->slab;
+    lockPool();
+    if(slab->usedCount == getChunksPerSlab(slab->sizeClass))
+        linkPartialSlab(slab);
+    *(Chunk**)chunk->buffer = slab->freeList;
+    slab->freeList = chunk;
+    slab->usedCount--;
+    this->freeMemory += chunk->memorySize();
+    // keep a reserve of free chunks to avoid mapping and unmapping in a loop
+    if(slab->usedCount == 0 && this->freeMemory > this->releaseWatermark + SlabSize){
+        unlinkPartialSlab(slab);
+        unmapSlab(slab);
+    }
+    unlockPool();
+}
+void ChunkStore::setReleaseWatermark(size_t bytes) {
+    lockPool();
+    this->releaseWatermark = bytes;
+    for(uint32_t i = 0;i < this->slabs.size();){
+        ChunkSlab *slab = this->slabs[i];
+        if(slab->usedCount == 0 && this->freeMemory > this->releaseWatermark + SlabSize){
+            unlinkPartialSlab(slab);
+            // swaps the last slab into i
+            unmapSlab(slab);
+        } else
+            i++;
+    }
+    unlockPool();
+}
+void ChunkStore::setHugePages(bool enable) {
+    lockPool();
+    this->hugePages = enable;
+    unlockPool();
+}
+#pragma endregion Slab
+
+ChunkStore::ChunkStore(){
+#if DOE_WIN32
+    this->chunkTable = (std::atomic<Chunk*>*)VirtualAlloc(nullptr, ChunkTableSize, MEM_RESERVE, PAGE_NOACCESS);
+    if(this->chunkTable == nullptr)
+        throw std::bad_alloc();
+#else
+    // untouched pages read as zero, only the ones holding used indices get backed
+    void *table = mmap(nullptr, ChunkTableSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(table == MAP_FAILED)
+        throw std::bad_alloc();
+    this->chunkTable = (std::atomic<Chunk*>*)table;
+#endif
+    for(auto& segment:this->segments)
+        segment.store(nullptr, std::memory_order_relaxed);
+    for(auto& word:this->segmentSummary)
+        word.store(0, std::memory_order_relaxed);
+}
+ChunkStore::~ChunkStore(){
+    for(ChunkSlab *slab:this->slabs){
+    #if DOE_WIN32
+        VirtualFree(slab->memory, 0, MEM_RELEASE);
+    #else
+        munmap(slab->memory, SlabSize);
+    #endif
+        delete slab;
     }
+    this->slabs.clear();
+    for(auto& nodeSlabs:this->partialSlabs)
+        for(auto& head:nodeSlabs)
+            head = nullptr;
+    for(auto& segment:this->segments)
+        allocator<Segment>().deallocate(segment.exchange(nullptr));
+    this->segmentCount = 0;
+#if DOE_WIN32
+    VirtualFree(this->chunkTable, 0, MEM_RELEASE);
+#else
+    munmap(this->chunkTable, ChunkTableSize);
+#endif
+    this->chunkTable = nullptr;
 };
-Chunk* ChunkStore::getChunkPointer(const ChunkIndex chunk) {
-    if(chunk > Constants::MaximumChunkCount)
-        return nullptr;
-    return chunks[chunk].load();
-}
-ChunkIndex ChunkStore::allocateChunk() {
-    uint32_t bitmask;
-    uint32_t buffer;
-    uint32_t s_index = 0;
-    uint32_t b_index = 0;
-    for(;b_index < ChunkBunchCount;){
-        bitmask = bitmasks[b_index].load(std::memory_order_acquire);
-        if(bitmask == ~(uint32_t)0) {
-            b_index++;
+#pragma region Index
+ChunkStore::IndexCache& ChunkStore::threadIndexCache() {
+    static std::atomic<uint32_t> threadCounter{0};
+    thread_local const uint32_t threadOrdinal = threadCounter.fetch_add(1, std::memory_order_relaxed);
+    return this->indexCaches[threadOrdinal % IndexCacheCount];
+}
+void ChunkStore::growSegments(uint32_t index) {
+    if(index >= SegmentCount)
+        throw std::runtime_error("AllocateChunk(): out of memory");
+    if(this->segments[index].load(std::memory_order_acquire) == nullptr){
+        Segment *segment = allocator<Segment>().allocate(1);
+        for(auto& word:segment->summary)
+            word.store(0, std::memory_order_relaxed);
+        for(auto& bitmask:segment->bitmasks)
+            bitmask.store(0, std::memory_order_relaxed);
+    #if DOE_WIN32
+        // committing twice is harmless, the pages keep their content
+        if(VirtualAlloc(this->chunkTable + ((size_t)index << SegmentShift), sizeof(std::atomic<Chunk*>) * SegmentSize, MEM_COMMIT, PAGE_READWRITE) == nullptr){
+            allocator<Segment>().deallocate(segment);
+            throw std::bad_alloc();
+        }
+    #endif
+        Segment *expected = nullptr;
+        // another allocator may win the race, its segment is as good as ours
+        if(!this->segments[index].compare_exchange_strong(expected, segment, std::memory_order_acq_rel))
+            allocator<Segment>().deallocate(segment);
+    }
+    uint32_t count = this->segmentCount.load(std::memory_order_acquire);
+    while(count <= index && !this->segmentCount.compare_exchange_weak(count, index + 1, std::memory_order_acq_rel))
+        ;
+}
+bool ChunkStore::claimInSegment(Segment *segment, uint32_t &index) {
+    for(uint32_t s_index = 0;s_index < SummaryCount;){
+        uint64_t full = segment->summary[s_index].load(std::memory_order_acquire);
+        if(full == ~(uint64_t)0){
+            s_index++;
             continue;
         }
-        for(;s_index<BitmaskSize;s_index++)
-            if ((bitmask & (1<<s_index)) == 0)
-                break;
-        buffer = bitmask | (1<<s_index);
-        if(bitmasks[b_index].compare_exchange_weak(bitmask, buffer, std::memory_order_acq_rel))
-            break;
-    }
-    if(b_index >= ChunkBunchCount)
-        throw std::runtime_error("AllocateChunk(): out of memory");
-    Chunk* v = allocator<Chunk>().allocate(1);
-    buffer = b_index * BitmaskSize + s_index;
-    chunks[buffer].store(v);
-    v->index = ChunkIndex(buffer);
-    return ChunkIndex(buffer);
+        const uint32_t b_index = s_index * BitmaskSize + countTrailingZeros(~full);
+        const uint64_t summaryBit = (uint64_t)1 << (b_index % BitmaskSize);
+        uint64_t bitmask = segment->bitmasks[b_index].load(std::memory_order_acquire);
+        while(bitmask != ~(uint64_t)0){
+            const uint64_t bit = (uint64_t)1 << countTrailingZeros(~bitmask);
+            if(segment->bitmasks[b_index].compare_exchange_weak(bitmask, bitmask | bit, std::memory_order_acq_rel)){
+                if((bitmask | bit) == ~(uint64_t)0){
+                    segment->summary[s_index].fetch_or(summaryBit, std::memory_order_acq_rel);
+                    // a free between the fill and the summary update would be hidden
+                    if(segment->bitmasks[b_index].load(std::memory_order_acquire) != ~(uint64_t)0)
+                        segment->summary[s_index].fetch_and(~summaryBit, std::memory_order_acq_rel);
+                }
+                index = b_index * BitmaskSize + countTrailingZeros(bit);
+                return true;
+            }
+        }
+        // word filled up by another thread, publish it and look again
+        segment->summary[s_index].fetch_or(summaryBit, std::memory_order_acq_rel);
+        if(segment->bitmasks[b_index].load(std::memory_order_acquire) != ~(uint64_t)0)
+            segment->summary[s_index].fetch_and(~summaryBit, std::memory_order_acq_rel);
+    }
+    return false;
+}
+ChunkIndex ChunkStore::claimIndex() {
+    while(true){
+        const uint32_t count = this->segmentCount.load(std::memory_order_acquire);
+        uint32_t g_index = 0;
+        for(;g_index < (count + BitmaskSize - 1) / BitmaskSize;){
+            uint64_t full = this->segmentSummary[g_index].load(std::memory_order_acquire);
+            // segments that are not published yet count as full
+            if(count < (g_index + 1) * BitmaskSize)
+                full |= ~(uint64_t)0 << (count % BitmaskSize);
+            if(full == ~(uint64_t)0){
+                g_index++;
+                continue;
+            }
+            const uint32_t segmentIndex = g_index * BitmaskSize + countTrailingZeros(~full);
+            const uint64_t segmentBit = (uint64_t)1 << (segmentIndex % BitmaskSize);
+            Segment *segment = this->segments[segmentIndex].load(std::memory_order_acquire);
+            uint32_t index;
+            if(claimInSegment(segment, index))
+                return ChunkIndex((segmentIndex << SegmentShift) | index);
+            this->segmentSummary[g_index].fetch_or(segmentBit, std::memory_order_acq_rel);
+            // same as a bitmasks word, a release may have slipped in
+            for(uint32_t s_index = 0;s_index < SummaryCount;s_index++)
+                if(segment->summary[s_index].load(std::memory_order_acquire) != ~(uint64_t)0){
+                    this->segmentSummary[g_index].fetch_and(~segmentBit, std::memory_order_acq_rel);
+                    break;
+                }
+        }
+        growSegments(count);
+    }
+}
+void ChunkStore::releaseIndex(uint32_t index) {
+    const uint32_t segmentIndex = index >> SegmentShift;
+    Segment *segment = this->segments[segmentIndex].load(std::memory_order_acquire);
+    index &= SegmentMask;
+    const uint32_t b_index = index / BitmaskSize;
+    const uint64_t bit = (uint64_t)1 << (index % BitmaskSize);
+    const uint64_t previous = segment->bitmasks[b_index].fetch_and(~bit, std::memory_order_acq_rel);
+    if(previous == ~(uint64_t)0){
+        segment->summary[b_index / BitmaskSize].fetch_and(~((uint64_t)1 << (b_index % BitmaskSize)), std::memory_order_acq_rel);
+        this->segmentSummary[segmentIndex / BitmaskSize].fetch_and(~((uint64_t)1 << (segmentIndex % BitmaskSize)), std::memory_order_acq_rel);
+    }
+}
+#pragma endregion Index
+
+ChunkIndex ChunkStore::allocateChunk(uint8_t sizeClass) {
+    return allocateChunk(sizeClass, getThreadNode());
+}
+ChunkIndex ChunkStore::allocateChunk(uint8_t sizeClass, uint32_t node) {
+    if(sizeClass >= Chunk::SizeClassCount)
+        throw std::invalid_argument("allocateChunk(): invalid size class");
+    if(node >= Constants::MaximumNodeCount)
+        throw std::invalid_argument("allocateChunk(): invalid node");
+    uint32_t index = UINT32_MAX;
+    IndexCache &cache = threadIndexCache();
+    uint32_t expected = 0;
+    // a contended cache is skipped rather than waited on
+    if(cache.busy.compare_exchange_strong(expected, 1, std::memory_order_acquire)){
+        if(cache.count)
+            index = cache.indices[--cache.count];
+        cache.busy.store(0, std::memory_order_release);
+    }
+    if(index == UINT32_MAX)
+        index = claimIndex();
+    Chunk* v;
+    try {
+        v = takeChunk(sizeClass, (uint8_t)node);
+    } catch(...) {
+        releaseIndex(index);
+        throw;
+    }
+    // recycled memory holds the previous owner's header
+    v->archetype = nullptr;
+    v->count = 0;
+    v->listWithEmptySlotsIndex = -1;
+    v->listIndex = -1;
+    v->index = ChunkIndex(index);
+    v->companion = nullptr;
+    this->chunkTable[index].store(v, std::memory_order_release);
+    return ChunkIndex(index);
 }
 void ChunkStore::freeChunk(const ChunkIndex chunk) {
-    if(chunk > Constants::MaximumChunkCount)
+    if(chunk >= Constants::MaximumChunkCount)
         return;
-    uint32_t s_index = chunk % BitmaskSize;
-    uint32_t b_index = chunk / BitmaskSize;
-    uint32_t bitmask = ~(1 << s_index);
-    bitmasks[b_index] &= bitmask;
-    Chunk* v = chunks[chunk].exchange(nullptr);
-    if(v)
-        allocator<Chunk>().deallocate(v,1);
-    else
+    // release the pointer before the index may be reused by another allocation
+    Chunk* v = chunk < getIndexCapacity() ? this->chunkTable[chunk].exchange(nullptr) : nullptr;
+    if(v == nullptr)
         throw std::invalid_argument("freeChunk(): invalid chunk");
-}
\ No newline at end of file
+    giveChunk(v);
+    IndexCache &cache = threadIndexCache();
+    uint32_t expected = 0;
+    if(cache.busy.compare_exchange_strong(expected, 1, std::memory_order_acquire)){
+        if(cache.count < IndexCacheSize){
+            cache.indices[cache.count++] = chunk;
+            cache.busy.store(0, std::memory_order_release);
+            return;
+        }
+        cache.busy.store(0, std::memory_order_release);
+    }
+    releaseIndex(chunk);
+}
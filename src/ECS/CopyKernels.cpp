@@ -0,0 +1,81 @@
+#include "ECS/CopyKernels.hpp"
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+using namespace ECS;
+
+namespace
+{
+    template<uint32_t S>
+    void copyStride(uint8_t *dst, const uint8_t *src, uint32_t count, uint32_t)
+    {
+        // the common case, moving a single entity between chunks
+        if (count == 1){
+            memcpy(dst, src, S);
+            return;
+        }
+        memcpy(dst, src, (size_t)count * S);
+    }
+} // namespace
+
+void CopyKernels::copyGeneric(uint8_t *dst, const uint8_t *src, uint32_t count, uint32_t sizeOf)
+{
+    memcpy(dst, src, (size_t)count * sizeOf);
+}
+void CopyKernels::fill(uint8_t *dst, const void *value, uint32_t count, uint32_t sizeOf)
+{
+    if (count == 0)
+        return;
+    memcpy(dst, value, sizeOf);
+    for (uint32_t written = 1; written < count; written *= 2)
+        memcpy(dst + (size_t)sizeOf * written, dst, (size_t)sizeOf * (written < count - written ? written : count - written));
+}
+void CopyKernels::copyStreaming(uint8_t *dst, const uint8_t *src, size_t bytes)
+{
+#if defined(__SSE2__)
+    // non-temporal stores need an aligned destination
+    const size_t head = (size_t)((0u - (uintptr_t)dst) & 15);
+    if (head > bytes){
+        memcpy(dst, src, bytes);
+        return;
+    }
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    bytes -= head;
+    for (; bytes >= 64; bytes -= 64, dst += 64, src += 64)
+    {
+        const __m128i a = _mm_loadu_si128((const __m128i*)src);
+        const __m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+        const __m128i c = _mm_loadu_si128((const __m128i*)(src + 32));
+        const __m128i d = _mm_loadu_si128((const __m128i*)(src + 48));
+        _mm_stream_si128((__m128i*)dst, a);
+        _mm_stream_si128((__m128i*)(dst + 16), b);
+        _mm_stream_si128((__m128i*)(dst + 32), c);
+        _mm_stream_si128((__m128i*)(dst + 48), d);
+    }
+    memcpy(dst, src, bytes);
+    // streaming stores are weakly ordered, publish them before the chunk is handed to anyone else
+    _mm_sfence();
+#else
+    memcpy(dst, src, bytes);
+#endif
+}
+CopyKernel CopyKernels::select(uint32_t sizeOf)
+{
+    switch (sizeOf)
+    {
+    case 1:  return copyStride<1>;
+    case 2:  return copyStride<2>;
+    case 4:  return copyStride<4>;
+    case 8:  return copyStride<8>;
+    case 12: return copyStride<12>;
+    case 16: return copyStride<16>;
+    case 24: return copyStride<24>;
+    case 32: return copyStride<32>;
+    case 48: return copyStride<48>;
+    case 64: return copyStride<64>;
+    default: return copyGeneric;
+    }
+}
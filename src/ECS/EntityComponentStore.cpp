@@ -2,6 +2,7 @@
 #include "ECS/Base/Constants.hpp"
 #include "ECS/Base/Chunk.hpp"
 #include "ECS/Archetype.hpp"
+#include <algorithm>
 
 using namespace ECS;
 EntityComponentStore::~EntityComponentStore(){
@@ -24,24 +25,37 @@ EntityComponentStore::EntityComponentStore(){
     this->typeLookup.init   (Constants::InitialArchetypeArraySize);
     this->archetypes.reserve(Constants::InitialArchetypeArraySize);
 }
-uint32_t EntityComponentStore::getComponentArraySize(uint32_t componentSize, uint32_t entityCount)
+uint32_t EntityComponentStore::getComponentArraySize(uint32_t componentSize, uint32_t entityCount, uint32_t alignment, bool aosoa)
 {
-    return alignCacheLineSize(componentSize * entityCount);
+    // the tail is padded so vector loops can run over Chunk::getPaddedCount elements
+    const uint32_t size = componentSize * (aosoa ? AoSoA::getPaddedCount(entityCount, componentSize) : Chunk::getPaddedCount(entityCount, componentSize));
+    return (size + alignment - 1) & ~(alignment - 1);
 }
-uint32_t EntityComponentStore::calculateSpaceRequirement(const_span<uint16_t> componentSizes, uint32_t entityCount)
+uint32_t EntityComponentStore::calculateSpaceRequirement(const_span<TypeID> types, const_span<uint16_t> componentSizes, const_span<uint16_t> componentAlignments, uint32_t entityCount, bool cold, uint32_t *offsets)
 {
-    uint32_t size = 0;
-    for (const auto& componentSize : componentSizes)
-        size += getComponentArraySize(componentSize, entityCount);
-    return size;
+    uint32_t usedBytes = Chunk::MemoryOffset;
+    for (uint32_t i = 0; i < componentSizes.size(); i++)
+    {
+        if (types[i].isCold() != cold)
+            continue;
+        const uint32_t alignment = componentAlignments[i];
+        usedBytes = (usedBytes + alignment - 1) & ~(alignment - 1);
+        if (offsets)
+            offsets[i] = usedBytes;
+        usedBytes += getComponentArraySize(componentSizes[i], entityCount, alignment, types[i].isAoSoA());
+    }
+    return usedBytes - Chunk::MemoryOffset;
 }
-uint32_t EntityComponentStore::calculateChunkCapacity(const_span<uint16_t> componentSizes, uint32_t bufferSize)
+uint32_t EntityComponentStore::calculateChunkCapacity(const_span<TypeID> types, const_span<uint16_t> componentSizes, const_span<uint16_t> componentAlignments, uint32_t bufferSize, bool cold)
 {
     uint32_t totalSize = 0;
-    for (const auto& componentSize : componentSizes)
-        totalSize += componentSize;
+    for (uint32_t i = 0; i < componentSizes.size(); i++)
+        if (types[i].isCold() == cold)
+            totalSize += componentSizes[i];
+    if (totalSize == 0)
+        return UINT32_MAX;
     uint32_t capacity = bufferSize / totalSize;
-    while (calculateSpaceRequirement(componentSizes, capacity) > bufferSize)
+    while (capacity > 0 && calculateSpaceRequirement(types, componentSizes, componentAlignments, capacity, cold) > bufferSize)
         --capacity;
     return capacity;
 }
@@ -77,31 +91,45 @@ Archetype* EntityComponentStore::createArchetype(const_span<TypeID> types){
     if(Constants::MaximumArchetypeSharedComponentCount < numSharedComponents)
         throw std::invalid_argument("validateArchetype(): too shareed components");
     {
-        uint32_t offsets[7];
+        uint32_t offsets[10];
         offsets[0] =              alignPointerSize(sizeof(Archetype));
         offsets[1] = offsets[0] + alignPointerSize(sizeof(TypeID)*types.size());
         offsets[2] = offsets[1] + alignPointerSize(sizeof(uint16_t)*types.size());
-        offsets[3] = offsets[2] + alignPointerSize(sizeof(uint32_t)*types.size());
+        offsets[3] = offsets[2] + alignPointerSize(sizeof(uint32_t)*types.size()*Chunk::SizeClassCount);
         offsets[4] = offsets[3] + alignPointerSize(sizeof(uint16_t)*types.size());
-        offsets[5] = offsets[4] + alignPointerSize(sizeof(TypeManager::DefaultFunction)*types.size());
+        offsets[5] = offsets[4] + alignPointerSize(sizeof(TypeManager::DestructFunction)*types.size());
         offsets[6] = offsets[5] + alignPointerSize(sizeof(TypeManager::DefaultFunction)*types.size());
-        arch.reset((Archetype*)std::allocator<uint8_t>().allocate(offsets[6]));
+        offsets[7] = offsets[6] + alignPointerSize(sizeof(CopyKernel)*types.size());
+        offsets[8] = offsets[7] + alignPointerSize(sizeof(const void*)*types.size());
+        offsets[9] = offsets[8] + alignPointerSize(sizeof(TypeManager::RelocateFunction)*types.size());
+        arch.reset((Archetype*)std::allocator<uint8_t>().allocate(offsets[9]));
         new (&arch->chunks) ArchetypeChunkData(types.size(),numSharedComponents);
         // arch->chunks.grow(Constants::InitialChunkListSize);
         new (&arch->chunksWithEmptySlots) std::vector<Chunk*>();
-        arch->chunksWithEmptySlots.reserve(Constants::InitialChunkListSize);
+        new (&arch->addEdges) std::vector<ArchetypeEdge>();
+        new (&arch->removeEdges) std::vector<ArchetypeEdge>();
+        new (&arch->conversions) std::vector<ArchetypeConversion>();
+        new (&arch->conversionColumns) std::vector<int16_t>();
         new (&arch->freeChunksBySharedComponents) ChunkListMap();
-        arch->freeChunksBySharedComponents.init(arch.get(), Constants::InitialChunkListSize);
+        // only one of the empty slot trackers is used, start both small and let them grow
+        if (numSharedComponents == 0)
+            arch->chunksWithEmptySlots.reserve(Constants::InitialEmptySlotListSize);
+        else
+            arch->freeChunksBySharedComponents.init(arch.get());
+        new (&arch->matchingQueryData) std::vector<EntityQueryData*>();
         arch->_types        = (TypeID*)  ((uint8_t*)(arch.get()) + offsets[0]);
         arch->_realIndecies = (uint16_t*)((uint8_t*)(arch.get()) + offsets[1]);
         arch->_offsets      = (uint32_t*)((uint8_t*)(arch.get()) + offsets[2]);
         arch->_sizeOfs      = (uint16_t*)((uint8_t*)(arch.get()) + offsets[3]);
-        arch->_dDestructor  = (TypeManager::DefaultFunction*)((uint8_t*)(arch.get()) + offsets[4]);
+        arch->_destructors  = (TypeManager::DestructFunction*)((uint8_t*)(arch.get()) + offsets[4]);
         arch->_dConstructor = (TypeManager::DefaultFunction*)((uint8_t*)(arch.get()) + offsets[5]);
+        arch->_copyKernels  = (CopyKernel*)((uint8_t*)(arch.get()) + offsets[6]);
+        arch->_prototypes   = (const void**)((uint8_t*)(arch.get()) + offsets[7]);
+        arch->_relocators   = (TypeManager::RelocateFunction*)((uint8_t*)(arch.get()) + offsets[8]);
     }
     arch->typeCount   = types.size();
-    arch->chunkCapacity = 0;
     arch->entityCount = 0;
+    arch->emptyFrames = 0;
     {
         uint16_t i = (uint16_t) types.size();
         do arch->firstSharedComponent = i;
@@ -115,7 +143,6 @@ Archetype* EntityComponentStore::createArchetype(const_span<TypeID> types){
     }
     arch->instanceSize = 0;
     arch->instanceSizeWithOverhead = 0;
-    arch->matchingQueryCount = 0;
     arch->flags = ArchetypeFlags::Empty;
     for (uint32_t i = 0; i < types.size(); ++i) {
         if (types[i].hasAssetRef())
@@ -123,7 +150,6 @@ Archetype* EntityComponentStore::createArchetype(const_span<TypeID> types){
     }
     arch->entityComponentStore = this;
     arch->nextChangedArchetype = nullptr;
-    new (&arch->queryMask) std::bitset<Constants::MaximumQueryCount>();
 
     memcpy(arch->_types,types.data(),types.size_bytes());
     for (uint32_t i = 0; i < types.size(); ++i)
@@ -131,24 +157,60 @@ Archetype* EntityComponentStore::createArchetype(const_span<TypeID> types){
     for (uint32_t i = 0; i < types.size(); ++i)
         arch->_sizeOfs[i] = (uint16_t) TypeManager::GetTypeInfo(types[i]).SizeInChunk;
     for (uint32_t i = 0; i < types.size(); ++i)
-        arch->_dDestructor[i] = TypeManager::GetTypeInfo(types[i]).defaultDestruct;
+        arch->_copyKernels[i] = CopyKernels::select(arch->_sizeOfs[i]);
+    for (uint32_t i = 0; i < types.size(); ++i)
+        arch->_destructors[i] = TypeManager::GetTypeInfo(types[i]).destruct;
+    for (uint32_t i = 0; i < types.size(); ++i)
+        arch->_relocators[i] = TypeManager::GetTypeInfo(types[i]).relocate;
     for (uint32_t i = 0; i < types.size(); ++i)
         arch->_dConstructor[i] = TypeManager::GetTypeInfo(types[i]).defaultConstruct;
+    for (uint32_t i = 0; i < types.size(); ++i)
+        arch->_prototypes[i] = TypeManager::GetTypeInfo(types[i]).Prototype;
 
 
-    arch->chunkCapacity = std::min(
-        calculateChunkCapacity({arch->_sizeOfs,types.size()},Chunk::BufferSize),
-        Constants::MaximumEntitiesPerChunk
-    );
-    for (uint32_t i = 0,usedBytes = Chunk::MemoryOffset; i < types.size(); i++)
+    // columns start at vector boundaries, or at the component alignment when it is stricter
+    uint16_t alignments[Constants::MaximumArchetypeComponentCount];
+    for (uint32_t i = 0; i < types.size(); ++i)
+    {
+        const uint32_t alignment = TypeManager::GetTypeInfo(types[i]).AlignmentInBytes;
+        // chunks are aligned to their size, the smallest one bounds the alignment we can honor
+        if (alignment > Chunk::getMemorySize(0))
+            throw std::invalid_argument("createArchetype(): component alignment exceeds chunk alignment");
+        alignments[i] = (uint16_t)std::max(alignment, Constants::ChunkColumnAlignment);
+    }
+    // cold columns go to a companion chunk, they only bound the capacity when they outgrow the largest chunk
+    const_span<uint16_t> sizes = {arch->_sizeOfs,types.size()};
+    bool hasColdComponents = false;
+    for (uint32_t i = 0; i < types.size(); ++i)
+        hasColdComponents |= types[i].isCold();
+    const uint32_t coldCapacity = hasColdComponents ?
+        calculateChunkCapacity(types,sizes,{alignments,types.size()},Chunk::getBufferSize(Chunk::SizeClassCount - 1),true) : UINT32_MAX;
+    for (uint32_t c = 0; c < Chunk::SizeClassCount; c++)
     {
-        arch->_offsets[i] = usedBytes;
-        usedBytes += getComponentArraySize(arch->_sizeOfs[i], arch->chunkCapacity);
+        const uint32_t capacity = std::min({
+            calculateChunkCapacity(types,sizes,{alignments,types.size()},Chunk::getBufferSize(c)),
+            Chunk::SizeClassEntityLimit[c],
+            coldCapacity
+        });
+        arch->chunkCapacity[c] = capacity;
+        calculateSpaceRequirement(types,sizes,{alignments,types.size()},capacity,false,arch->_offsets + c * types.size());
+        arch->coldSizeClass[c] = Chunk::SizeClassCount;
+        if (!hasColdComponents)
+            continue;
+        // smallest companion holding the cold columns of a full chunk
+        const uint32_t coldBytes = calculateSpaceRequirement(types,sizes,{alignments,types.size()},capacity,true,arch->_offsets + c * types.size());
+        uint8_t k = 0;
+        while (Chunk::getBufferSize(k) < coldBytes)
+            k++;
+        arch->coldSizeClass[c] = k;
     }
+    arch->sizeClass = selectSizeClass(arch.get(), 0);
+    // enabled bits only cover the largest chunk this archetype can get
+    arch->chunks.setEntityCapacity(*std::max_element(arch->chunkCapacity, arch->chunkCapacity + Chunk::SizeClassCount));
     for (uint32_t i = 0; i < arch->numNonZeroSizedTypes(); i++)
     {
         arch->instanceSize += arch->_sizeOfs[i];
-        arch->instanceSizeWithOverhead += getComponentArraySize(arch->_sizeOfs[i], 1);
+        arch->instanceSizeWithOverhead += getComponentArraySize(arch->_sizeOfs[i], 1, alignments[i], types[i].isAoSoA());
     }
     this->archetypes.emplace_back(arch.get());
     this->typeLookup.add(arch.get());
@@ -212,6 +274,18 @@ void EntityComponentStore::destroyBatch(EntityBatchInChunk batch){
     Archetype *arch = this->getArchetype(batch.chunk);
     arch->deallocate(batch);
 }
+void EntityComponentStore::destroyChunk(Chunk* chunk){
+    Archetype *arch = chunk->archetype;
+    const uint32_t count = chunk->count;
+    deallocateManagedComponents(EntityBatchInChunk{ .chunk = chunk, .startIndex = 0, .count = count });
+    this->freeEntities(chunk);
+    // no entity is left to fill the holes, the chunk goes back to the pool as is
+    const SharedComponentValues sharedComponentValues = arch->chunks.getSharedComponentValues(chunk->listIndex);
+    this->incrementComponentOrderVersion(arch, sharedComponentValues);
+    this->incrementComponentTypeOrderVersion(arch);
+    arch->entityCount -= count;
+    arch->setChunkCount(chunk, 0);
+}
 void EntityComponentStore::freeEntities(Chunk* chunk)
 {   
     this->entityStore.deallocateEntities({(Entity*)chunk->buffer, chunk->count});
@@ -223,15 +297,137 @@ Chunk* EntityComponentStore::getChunkWithEmptySlots(Archetype* archetype, const
         chunk = this->getCleanChunk(archetype, sharedComponentIndecies);
     return chunk;
 }
+uint32_t EntityComponentStore::compactChunk(Chunk *srcChunk, Chunk *dstChunk, uint32_t count)
+{
+    if(srcChunk == dstChunk || srcChunk->archetype != dstChunk->archetype)
+        throw std::invalid_argument("compactChunk(): invalid chunks");
+    Archetype *archetype = srcChunk->archetype;
+    Version globalSystemVersion = this->getGlobalSystemVersion();
+    count = std::min(count, srcChunk->count);
+    uint32_t dstIndex;
+    count = archetype->allocateIntoChunk(dstChunk, count, dstIndex);
+    if (count == 0)
+        return 0;
+    const uint32_t srcIndex = srcChunk->count - count;
+    Archetype::copy(srcChunk, srcIndex, dstChunk, dstIndex, count);
+    Entity *movedEntities = (Entity*)dstChunk->buffer + dstIndex;
+    for (uint32_t i = 0; i < count; i++)
+        this->setEntityInChunk(movedEntities[i], { dstChunk, dstIndex + i });
+
+    // Add Entities in Chunk. ChangeVersion:Yes OrderVersion:Yes
+    Archetype::cloneChangeVersions(archetype, srcChunk->listIndex, archetype, dstChunk->listIndex, true);
+    archetype->chunks.setOrderVersion(dstChunk->listIndex, globalSystemVersion);
+    this->incrementComponentTypeOrderVersion(archetype);
+    const SharedComponentValues dstSharedComponentValues = archetype->chunks.getSharedComponentValues(dstChunk->listIndex);
+    this->incrementComponentOrderVersion(archetype, dstSharedComponentValues);
+
+    // tail of the source, nothing to fill
+    Archetype::remove({ srcChunk, srcIndex, count });
+    return count;
+}
+uint32_t EntityComponentStore::defragmentArchetype(Archetype *archetype, uint32_t entityBudget, DefragmentStats &stats)
+{
+    uint32_t moved = 0;
+    while (moved < entityBudget)
+    {
+        Chunk *srcChunk = nullptr;
+        Chunk *dstChunk = nullptr;
+        if (archetype->numSharedComponents() == 0)
+        {
+            std::vector<Chunk*,allocator<Chunk*>> &candidates = archetype->chunksWithEmptySlots;
+            if (candidates.size() < 2)
+                break;
+            uint32_t freeSlots = 0;
+            for (Chunk *chunk:candidates)
+            {
+                freeSlots += archetype->getChunkCapacity(chunk) - chunk->count;
+                if (srcChunk == nullptr || chunk->count < srcChunk->count)
+                    srcChunk = chunk;
+            }
+            // merging pays off only if the sparsest chunk can be emptied
+            if (freeSlots - (archetype->getChunkCapacity(srcChunk) - srcChunk->count) < srcChunk->count)
+                break;
+            for (Chunk *chunk:candidates)
+                if (chunk != srcChunk && (dstChunk == nullptr || chunk->count > dstChunk->count))
+                    dstChunk = chunk;
+        }
+        else
+        {
+            srcChunk = archetype->freeChunksBySharedComponents.getSparsest();
+            if (srcChunk == nullptr)
+                break;
+            const SharedComponentValues sharedComponentValues = archetype->chunks.getSharedComponentValues(srcChunk->listIndex);
+            dstChunk = archetype->freeChunksBySharedComponents.tryGetFullest(sharedComponentValues, archetype->numSharedComponents(), srcChunk);
+            if (dstChunk == nullptr)
+                break;
+        }
+        const uint32_t srcCount = srcChunk->count;
+        const uint32_t memorySize = srcChunk->memorySize();
+        const uint32_t count = this->compactChunk(srcChunk, dstChunk, std::min(srcCount, entityBudget - moved));
+        if (count == 0)
+            break;
+        moved += count;
+        if (count == srcCount)
+        {
+            stats.reclaimedChunks++;
+            stats.reclaimedBytes += memorySize;
+        }
+    }
+    return moved;
+}
+DefragmentStats EntityComponentStore::defragment(uint32_t entityBudget)
+{
+    DefragmentStats stats;
+    const uint32_t archetypeCount = (uint32_t)this->archetypes.size();
+    for (uint32_t visited = 0; visited < archetypeCount && stats.movedEntities < entityBudget; visited++)
+    {
+        if (this->defragmentCursor >= archetypeCount)
+            this->defragmentCursor = 0;
+        Archetype *archetype = this->archetypes[this->defragmentCursor].get();
+        const uint32_t moved = this->defragmentArchetype(archetype, entityBudget - stats.movedEntities, stats);
+        stats.movedEntities += moved;
+        // stay on a partially processed archetype for the next pass
+        if (stats.movedEntities < entityBudget)
+            this->defragmentCursor++;
+    }
+    return stats;
+}
+uint8_t EntityComponentStore::selectSizeClass(const Archetype* archetype, uint32_t population)
+{
+    uint8_t selected = Chunk::SizeClassCount;
+    for (uint8_t c = 0; c < Chunk::SizeClassCount; c++)
+    {
+        const uint32_t capacity = archetype->chunkCapacity[c];
+        // a larger class only pays off when more entities fit into it
+        if (capacity == 0 || (selected != Chunk::SizeClassCount && capacity <= archetype->chunkCapacity[selected]))
+            continue;
+        selected = c;
+        if (population <= capacity)
+            break;
+    }
+    if (selected == Chunk::SizeClassCount)
+        throw std::invalid_argument("selectSizeClass(): archetype does not fit into a chunk");
+    return selected;
+}
 Chunk* EntityComponentStore::getCleanChunk(Archetype* archetype, SharedComponentValues sharedComponentValues)
 {
-    Chunk *newChunk = allocateChunk();
+    // grow the class of new chunks once the archetype has outgrown a few chunks of the current one
+    const uint32_t promotionPopulation = archetype->chunkCapacity[archetype->sizeClass] * Constants::SizeClassPromotionChunkCount;
+    if (archetype->entityCount >= promotionPopulation)
+        archetype->sizeClass = selectSizeClass(archetype, promotionPopulation + 1);
+    Chunk *newChunk = allocateChunk(archetype->sizeClass);
+    if (archetype->hasColdComponents())
+    {
+        // the companion lives next to its chunk
+        ChunkIndex companionIndex = chunks.allocateChunk(archetype->coldSizeClass[newChunk->sizeClass], newChunk->node);
+        newChunk->companion = chunks.getChunkPointer(companionIndex);
+    }
     archetype->addEmptyChunk(newChunk, sharedComponentValues);
     return newChunk;
 }
-Chunk* EntityComponentStore::allocateChunk()
+Chunk* EntityComponentStore::allocateChunk(uint8_t sizeClass)
 {
-    ECS::ChunkIndex newChunkIndex = chunks.allocateChunk();
+    ECS::ChunkIndex newChunkIndex = chunks.allocateChunk(sizeClass);
     return chunks.getChunkPointer(newChunkIndex);
 }
 SharedComponentIndex EntityComponentStore::getSharedComponentDataIndex(Entity entity, TypeID type)
@@ -259,6 +455,32 @@ void* EntityComponentStore::getComponentDataWithTypeRW(Entity entity, TypeID typ
     Archetype *archetype = this->getArchetype(entityInChunk.chunk);
     return archetype->getComponentDataWithTypeRW(entityInChunk.chunk, entityInChunk.indexInChunk, type, globalVersion);
 }
+void EntityComponentStore::getComponentData(Entity entity, TypeID type, void *out)
+{
+    EntityInChunk entityInChunk = this->getEntityInChunk(entity);
+    Archetype* archetype = this->getArchetype(entityInChunk.chunk);
+    const uint32_t sizeOf = TypeManager::GetTypeInfo(type).SizeInChunk;
+    if (!type.isAoSoA()){
+        memcpy(out, archetype->getComponentDataWithTypeRO(entityInChunk.chunk, entityInChunk.indexInChunk, type), sizeOf);
+        return;
+    }
+    const uint32_t blockStart = entityInChunk.indexInChunk & ~(AoSoA::BlockSize - 1);
+    const uint8_t *block = archetype->getComponentDataWithTypeRO(entityInChunk.chunk, blockStart, type);
+    AoSoA::load(block, entityInChunk.indexInChunk - blockStart, sizeOf, out);
+}
+void EntityComponentStore::setComponentData(Entity entity, TypeID type, const void *in)
+{
+    EntityInChunk entityInChunk = this->getEntityInChunk(entity);
+    Archetype *archetype = this->getArchetype(entityInChunk.chunk);
+    const uint32_t sizeOf = TypeManager::GetTypeInfo(type).SizeInChunk;
+    if (!type.isAoSoA()){
+        memcpy(archetype->getComponentDataWithTypeRW(entityInChunk.chunk, entityInChunk.indexInChunk, type, globalVersion), in, sizeOf);
+        return;
+    }
+    const uint32_t blockStart = entityInChunk.indexInChunk & ~(AoSoA::BlockSize - 1);
+    uint8_t *block = archetype->getComponentDataWithTypeRW(entityInChunk.chunk, blockStart, type, globalVersion);
+    AoSoA::store(block, entityInChunk.indexInChunk - blockStart, sizeOf, in);
+}
 
 void EntityComponentStore::validateEntities(span<Entity> entities){
     for(auto entity:entities){
@@ -277,12 +499,73 @@ uint32_t EntityComponentStore::countEntities(){
     return total;
 }
 void EntityComponentStore::createEntities(Archetype* archetype, span<Entity> entities, SharedComponentValues values){
+    this->createEntities(archetype, entities, {}, values);
+}
+void EntityComponentStore::createEntities(Archetype* archetype, span<Entity> entities, const_span<ComponentColumn> columns, const SharedComponentValues values){
+    for (uint32_t i = 0; i < columns.size(); i++)
+    {
+        const TypeID type = columns[i].type;
+        if (archetype->getIndexInTypeArray(type) <= 0)
+            throw std::invalid_argument("createEntities(): type is not a component of the archetype");
+        if (type.isZeroSized() || type.isManagedComponent() || type.isSharedComponent())
+            throw std::invalid_argument("createEntities(): only unmanaged data components can be copied");
+        if (columns[i].data == nullptr)
+            throw std::invalid_argument("createEntities(): nullptr");
+        for (uint32_t j = 0; j < i; j++)
+            if (columns[j].type == type)
+                throw std::invalid_argument("createEntities(): repeated type");
+    }
+    uint32_t sourceIndex = 0;
+    while (entities.size())
+    {
+        Chunk* chunk = getChunkWithEmptySlots(archetype, values);
+        uint32_t unusedCount = archetype->getChunkCapacity(chunk) - chunk->count;
+        uint32_t allocateCount = std::min(entities.size(), unusedCount);
+        archetype->allocate(chunk, allocateCount, entities.data(), columns, sourceIndex);
+        entities += allocateCount;
+        sourceIndex += allocateCount;
+    }
+}
+void EntityComponentStore::instantiate(Entity prefab, span<Entity> entities){
+    if (!this->exists(prefab))
+        throw std::invalid_argument("instantiate(): prefab does not exist");
+    if (entities.empty())
+        return;
+    // allocation only appends to chunks, the prefab stays where it is
+    const EntityInChunk prototype = this->getEntityInChunk(prefab);
+    Archetype *archetype = prototype.chunk->archetype;
+    if (archetype->numManagedComponents() != 0)
+        throw std::invalid_argument("instantiate(): managed components can not be cloned");
+    // copied, the chunk list holding them may grow while allocating
+    SharedComponentIndex sharedComponentValues[Constants::MaximumArchetypeSharedComponentCount];
+    archetype->chunks.getSharedComponentValues(prototype.chunk->listIndex).copyTo(sharedComponentValues, 0, (int)archetype->numSharedComponents());
+    const SharedComponentValues values{sharedComponentValues, sizeof(SharedComponentIndex)};
     while (entities.size())
     {
         Chunk* chunk = getChunkWithEmptySlots(archetype, values);
-        uint32_t unusedCount = archetype->chunkCapacity - chunk->count;
+        uint32_t unusedCount = archetype->getChunkCapacity(chunk) - chunk->count;
         uint32_t allocateCount = std::min(entities.size(), unusedCount);
-        archetype->allocate(chunk, allocateCount, entities.data());
+        archetype->instantiate(chunk, allocateCount, entities.data(), prototype.chunk, prototype.indexInChunk);
+        entities += allocateCount;
+    }
+}
+void EntityComponentStore::createReservedEntities(Archetype* archetype, const_span<Entity> entities, const SharedComponentValues values){
+    for (uint32_t i = 0; i < entities.size(); i++)
+        if (!this->entityStore.isReserved(entities[i]))
+            throw std::invalid_argument("createReservedEntities(): entity is not reserved");
+    // placing the first copy makes a repeated entity fail the check above, look for repeats before touching anything
+    std::vector<int32_t> indices(entities.size());
+    for (uint32_t i = 0; i < entities.size(); i++)
+        indices[i] = entities[i].index();
+    std::sort(indices.begin(), indices.end());
+    if (std::adjacent_find(indices.begin(), indices.end()) != indices.end())
+        throw std::invalid_argument("createReservedEntities(): repeated entity");
+    while (entities.size())
+    {
+        Chunk* chunk = getChunkWithEmptySlots(archetype, values);
+        uint32_t unusedCount = archetype->getChunkCapacity(chunk) - chunk->count;
+        uint32_t allocateCount = std::min(entities.size(), unusedCount);
+        archetype->allocateReserved(chunk, allocateCount, entities.data());
         entities += allocateCount;
     }
 }
@@ -319,6 +602,17 @@ EntityBatchInChunk EntityComponentStore::getFirstEntityBatchInChunk(const_span<E
 void EntityComponentStore::destroyEntities(const_span<Entity> entities){
     while(!entities.empty())
     {
+        // whole chunk fast path, the entities are listed in chunk order, e.g. the output of createEntities.
+        // the entity column of a chunk holds live entities only, so matching it validates the whole batch at once
+        Chunk *chunk = this->entityStore.getChunkIfExists(entities[0]);
+        if (chunk != nullptr && chunk->count <= entities.size() &&
+            0 == memcmp(chunk->buffer, entities.data(), chunk->count * sizeof(Entity)))
+        {
+            const uint32_t count = chunk->count;
+            destroyChunk(chunk);
+            entities += count;
+            continue;
+        }
         EntityBatchInChunk batch = getFirstEntityBatchInChunk(entities);
         if (batch.chunk == nullptr)
         {
@@ -382,13 +676,12 @@ void EntityComponentStore::deallocateManagedComponents(EntityBatchInChunk batch)
     uint32_t endManagedComponents = firstManagedComponent + archetype->numManagedComponents();
     for (uint32_t localTypeIndex = firstManagedComponent; localTypeIndex < endManagedComponents; ++localTypeIndex)
     {
-        TypeManager::DefaultFunction dFunc = TypeManager::GetTypeInfo(archetype->_types[localTypeIndex]).defaultDestruct;
+        TypeManager::DestructFunction destruct = archetype->_destructors[localTypeIndex];
+        if (destruct == nullptr)
+            continue;
         uint32_t sizeOf = archetype->_sizeOfs[localTypeIndex];
         uint8_t *ptr = (uint8_t*)archetype->getComponentDataRO(batch.chunk, 0, localTypeIndex);
-        for (uint32_t ei = 0; ei < batch.count; ++ei)
-        {
-            dFunc(ptr + sizeOf * (ei + batch.startIndex));
-        }
+        destruct(ptr + sizeOf * batch.startIndex, batch.count);
     }
 }
 void EntityComponentStore::addExistingEntitiesInChunk(Chunk *chunk)
@@ -447,6 +740,15 @@ bool EntityComponentStore::exists(Entity entity){
         return false;
     return true;
 }
+const EntityName* EntityComponentStore::getName(Entity entity){
+    return this->entityStore.getEntityName(entity);
+}
+void EntityComponentStore::setName(Entity entity, const EntityName* name){
+    this->entityStore.setEntityName(entity, name);
+}
+Entity EntityComponentStore::findEntityByName(const EntityName &name){
+    return this->entityStore.findEntityByName(name);
+}
 bool EntityComponentStore::hasComponent(Entity entity, TypeID type){
     bool entityExists = exists(entity);
     if (unlikely(!entityExists))
@@ -466,6 +768,8 @@ Archetype* EntityComponentStore::getArchetypeWithAddedComponents(Archetype* srcA
 {
     if(0 == types.size())
         return nullptr;
+    if(1 == types.size())
+        return getArchetypeWithAddedComponent(srcArchetype, types[0]);
     TypeID* srcTypes = srcArchetype->_types;
     uint32_t dstTypesCount = srcArchetype->typeCount + types.size();
     TypeID dstTypes[dstTypesCount];
@@ -506,6 +810,13 @@ Archetype* EntityComponentStore::getArchetypeWithAddedComponents(Archetype* srcA
 
 Archetype* EntityComponentStore::getArchetypeWithAddedComponent(Archetype* archetype, TypeID type, uint32_t* indexInTypeArray)
 {
+    const ArchetypeEdge *edge = Archetype::findEdge(archetype->addEdges, type);
+    if (edge != nullptr)
+    {
+        if (indexInTypeArray != nullptr)
+            *indexInTypeArray = edge->indexInTypeArray;
+        return edge->archetype;
+    }
     TypeID *types = archetype->_types;
     const uint32_t oldSize = archetype->typeCount;
     TypeID newTypes[oldSize + 1];
@@ -518,38 +829,55 @@ Archetype* EntityComponentStore::getArchetypeWithAddedComponent(Archetype* arche
     if (indexInTypeArray != nullptr)
         *indexInTypeArray = t;
     if (t != oldSize && types[t] == type)
+    {
         // Tag component type is already there, no new archetype required.
+        archetype->addEdges.push_back({type, nullptr, t});
         return nullptr;
+    }
+    const uint32_t index = t;
     newTypes[t] = type;
     while (t < oldSize)
     {
         newTypes[t + 1] = types[t];
         ++t;
     }
-    return getOrCreateArchetype({newTypes, oldSize + 1});
+    Archetype *dstArchetype = getOrCreateArchetype({newTypes, oldSize + 1});
+    archetype->addEdges.push_back({type, dstArchetype, index});
+    return dstArchetype;
 }
 Archetype* EntityComponentStore::getArchetypeWithRemovedComponent(Archetype* archetype, TypeID type, uint32_t* indexInOldTypeArray)
 {
+    const ArchetypeEdge *edge = Archetype::findEdge(archetype->removeEdges, type);
+    if (edge != nullptr)
+    {
+        if (indexInOldTypeArray != nullptr && edge->archetype != nullptr)
+            *indexInOldTypeArray = edge->indexInTypeArray;
+        return edge->archetype;
+    }
     TypeID *types = archetype->_types;
     const uint32_t oldSize = archetype->typeCount;
     TypeID newTypes[oldSize];
     uint32_t removedTypes = 0;
+    uint32_t index = 0;
     for (uint32_t t = 0; t < oldSize; ++t)
         if (types[t] == type)
         {
-            if (indexInOldTypeArray != nullptr)
-                *indexInOldTypeArray = t;
+            index = t;
             ++removedTypes;
         }
         else
             newTypes[t - removedTypes] = types[t];
-    if(removedTypes == 0)
-        return nullptr;
-    return getOrCreateArchetype({newTypes, oldSize - removedTypes});
+    Archetype *dstArchetype = removedTypes == 0 ? nullptr : getOrCreateArchetype({newTypes, oldSize - removedTypes});
+    archetype->removeEdges.push_back({type, dstArchetype, index});
+    if (indexInOldTypeArray != nullptr && dstArchetype != nullptr)
+        *indexInOldTypeArray = index;
+    return dstArchetype;
 }
 
 Archetype* EntityComponentStore::getArchetypeWithRemovedComponents(Archetype* archetype, const_span<TypeID> types)
 {
+    if (1 == types.size())
+        return getArchetypeWithRemovedComponent(archetype, types[0]);
     TypeID *srcTypes = archetype->_types;
     const uint32_t oldSize = archetype->typeCount;
     TypeID newTypes[oldSize];
@@ -565,7 +893,7 @@ Archetype* EntityComponentStore::getArchetypeWithRemovedComponents(Archetype* ar
                 goto remove;
             }
         }
-        newTypes[t - numRemovedTypes] = types[t];
+        newTypes[t - numRemovedTypes] = srcTypes[t];
         remove:;
     }
     if (numRemovedTypes == 0)
@@ -577,7 +905,7 @@ uint32_t EntityComponentStore::move(EntityBatchInChunk srcBatch, Chunk* dstChunk
 {
     Archetype *srcArchetype = this->getArchetype(srcBatch.chunk);
     Archetype *dstArchetype = this->getArchetype(dstChunk);
-    uint32_t   dstUnusedCount = dstArchetype->chunkCapacity - dstChunk->count;
+    uint32_t   dstUnusedCount = dstArchetype->getChunkCapacity(dstChunk) - dstChunk->count;
 
     EntityBatchInChunk partialSrcBatch;
     partialSrcBatch.chunk = srcBatch.chunk;
@@ -658,6 +986,44 @@ bool EntityComponentStore::removeComponent(EntityBatchInChunk entityBatchInChunk
     this->move(entityBatchInChunk, dstArchetype, {outSharedComponentValues,sizeof(SharedComponentIndex)});
     return true;
 }
+uint32_t EntityComponentStore::addComponent(Archetype *srcArchetype, TypeID type){
+    SharedComponentIndex outSharedComponentValues[Constants::MaximumArchetypeSharedComponentCount];
+    uint32_t indexInTypeArray;
+    Archetype *dstArchetype = getArchetypeWithAddedComponent(srcArchetype, type, &indexInTypeArray);
+    if (dstArchetype == nullptr)
+        return 0;
+    const SharedComponentIndex value = type.isSharedComponent() ? sharedComponents.getDefaultValue(type) : SharedComponentIndex();
+    uint32_t changed = 0;
+    // every move takes the chunk out of the source archetype
+    while (!srcArchetype->chunks.empty())
+    {
+        Chunk *chunk = srcArchetype->chunks[srcArchetype->chunks.count() - 1];
+        if (unlikely(chunk->count == 0))
+            throw std::runtime_error("addComponent(): empty chunk in archetype");
+        changed += chunk->count;
+        buildSharedComponentIndicesWithAddedComponent(chunk,dstArchetype,indexInTypeArray,value,outSharedComponentValues);
+        this->move(chunk, dstArchetype, {outSharedComponentValues,sizeof(SharedComponentIndex)});
+    }
+    return changed;
+}
+uint32_t EntityComponentStore::removeComponent(Archetype *srcArchetype, TypeID type){
+    SharedComponentIndex outSharedComponentValues[Constants::MaximumArchetypeSharedComponentCount];
+    uint32_t indexInTypeArray;
+    Archetype *dstArchetype = getArchetypeWithRemovedComponent(srcArchetype, type, &indexInTypeArray);
+    if (dstArchetype == nullptr)
+        return 0;
+    uint32_t changed = 0;
+    while (!srcArchetype->chunks.empty())
+    {
+        Chunk *chunk = srcArchetype->chunks[srcArchetype->chunks.count() - 1];
+        if (unlikely(chunk->count == 0))
+            throw std::runtime_error("removeComponent(): empty chunk in archetype");
+        changed += chunk->count;
+        buildSharedComponentIndicesWithRemovedComponent(chunk,dstArchetype,indexInTypeArray,outSharedComponentValues);
+        this->move(chunk, dstArchetype, {outSharedComponentValues,sizeof(SharedComponentIndex)});
+    }
+    return changed;
+}
 /// @param types sorted
 bool EntityComponentStore::addComponents(EntityBatchInChunk entityBatchInChunk, const_span<TypeID> types){
     SharedComponentIndex outSharedComponentValues[Constants::MaximumArchetypeSharedComponentCount];
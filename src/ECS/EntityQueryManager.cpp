@@ -2,6 +2,7 @@
 #include "ECS/Base/Query.hpp"
 #include "ECS/Archetype.hpp"
 #include "ECS/EntityComponentStore.hpp"
+#include <algorithm>
 
 using namespace ECS;
 bool EntityQueryManager::testMatchingArchetypeRequiredComponent(const_span<TypeID> archetypeTypes, const_span<EntityQueryData::TypeQuery> queryTypes){
@@ -79,10 +80,10 @@ void EntityQueryManager::addArchetypeIfMatching(Archetype *archetype, EntityQuer
     if(!testMatchingArchetypeExcludedComponent(archetypeTypes, {queries + query.firstNoneIndex, noneCount}))
         return;
     
-    if(archetype->queryMask.test(query.ID))
+    std::vector<EntityQueryData*> &matchingQueryData = archetype->matchingQueryData;
+    if(std::find(matchingQueryData.begin(), matchingQueryData.end(), &query) != matchingQueryData.end())
         return;
-    archetype->matchingQueryData[archetype->matchingQueryCount++] = &query;
-    archetype->queryMask.set(query.ID,true);
+    matchingQueryData.push_back(&query);
     query.invalidateCache();
 
     const uint32_t archetypeIndex = query.archetypesCount;
@@ -178,20 +179,100 @@ EntityQueryImpl EntityQueryManager::createEntityQuery(const EntityQueryBuilder&
         addArchetypeIfMatching(arch,*queryData);
     return EntityQueryImpl{queryData};
 }
+void EntityQueryManager::removeArchetype(const Archetype *archetype, EntityQueryData &query){
+    const uint32_t queryCount = query.firstNoneIndex;
+    EntityQueryData::ArchetypeCache *archetypes = query.archetypes.get();
+    for (uint32_t i = 0; i < query.archetypesCount; i++)
+    {
+        if (archetypes[i] != archetype)
+            continue;
+        const uint32_t tail = query.archetypesCount - i - 1;
+        memmove(archetypes + i, archetypes + i + 1, sizeof(EntityQueryData::ArchetypeCache) * tail);
+        memmove(query.typesIndex + i * queryCount, query.typesIndex + (i + 1) * queryCount, sizeof(int32_t) * queryCount * tail);
+        query.archetypesCount--;
+        query.invalidateCache();
+        return;
+    }
+}
 void EntityComponentStore::cleanChangeList()
 {
     Archetype *archetype = chunkListChangesTracker.head;
     while(archetype != nullptr)
     {
-        span<EntityQueryData*> matchingQuery = {archetype->matchingQueryData,archetype->matchingQueryCount};
-        for (uint32_t queryIndex = 0; queryIndex < matchingQuery.size(); ++queryIndex)
-            matchingQuery[queryIndex]->invalidateCache();
+        for (EntityQueryData *query:archetype->matchingQueryData)
+            query->invalidateCache();
         Archetype *nextArchetype = archetype->nextChangedArchetype;
         archetype->nextChangedArchetype = nullptr;
         archetype = nextArchetype;
     }
     chunkListChangesTracker.head = nullptr;
 }
+uint32_t EntityComponentStore::collectEmptyArchetypes()
+{
+    if (this->archetypeRetireFrames == 0)
+        return 0;
+    uint32_t retired = 0;
+    for (std::unique_ptr<Archetype> &archetype:this->archetypes)
+    {
+        if (archetype->entityCount != 0 || !archetype->chunks.empty())
+        {
+            archetype->emptyFrames = 0;
+            continue;
+        }
+        if (++archetype->emptyFrames < this->archetypeRetireFrames)
+            continue;
+        archetype->emptyFrames = Archetype::RetiredMark;
+        retired++;
+    }
+    if (retired == 0)
+        return 0;
+
+    // the change list links archetypes together, flush it before any of them goes away
+    this->cleanChangeList();
+    for (std::unique_ptr<Archetype> &archetype:this->archetypes)
+    {
+        if (archetype->emptyFrames == Archetype::RetiredMark)
+        {
+            for (EntityQueryData *query:archetype->matchingQueryData)
+                EntityQueryManager::removeArchetype(archetype.get(), *query);
+            this->typeLookup.remove(archetype.get());
+            continue;
+        }
+        // forget cached transitions to retired archetypes, they are rebuilt on demand
+        auto isRetired = [](const ArchetypeEdge &edge){
+            return edge.archetype != nullptr && edge.archetype->emptyFrames == Archetype::RetiredMark;
+        };
+        archetype->addEdges.erase(std::remove_if(archetype->addEdges.begin(), archetype->addEdges.end(), isRetired), archetype->addEdges.end());
+        archetype->removeEdges.erase(std::remove_if(archetype->removeEdges.begin(), archetype->removeEdges.end(), isRetired), archetype->removeEdges.end());
+        for (const ArchetypeConversion &conversion:archetype->conversions)
+            if (conversion.archetype->emptyFrames == Archetype::RetiredMark)
+            {
+                archetype->conversions.clear();
+                archetype->conversionColumns.clear();
+                break;
+            }
+    }
+    // keep the creation order, EntityQueryManager::updateNewArchetypes relies on it
+    uint32_t kept = 0;
+    const uint32_t previousCount = this->previousArchetypeCount;
+    for (uint32_t i = 0; i < this->archetypes.size(); i++)
+    {
+        if (this->archetypes[i]->emptyFrames == Archetype::RetiredMark)
+        {
+            if (i < previousCount)
+                this->previousArchetypeCount--;
+            continue;
+        }
+        if (kept != i)
+            this->archetypes[kept] = std::move(this->archetypes[i]);
+        kept++;
+    }
+    // frees the retired archetypes
+    this->archetypes.resize(kept);
+    if (this->defragmentCursor >= kept)
+        this->defragmentCursor = 0;
+    return retired;
+}
 void EntityQueryManager::addAdditionalArchetypes(span<Archetype*> archetypeList)
 {
     for (Archetype *arch:archetypeList)
@@ -212,6 +293,38 @@ void EntityQueryManager::updateNewArchetypes()
         this->addAdditionalArchetypes(archs);
     }
 }
+void EntityQueryManager::getMatchingArchetypes(EntityQueryImpl query, std::vector<Archetype*> &out)
+{
+    if(!query.queryData)
+        throw std::runtime_error("getMatchingArchetypes(): not initialized");
+    this->updateNewArchetypes();
+    const EntityQueryData *data = query.queryData;
+    out.clear();
+    for (uint32_t a = 0; a < data->archetypesCount; a++)
+        if (data->archetypes[a]->count() > 0)
+            out.push_back(const_cast<Archetype*>(data->archetypes[a]));
+}
+uint32_t EntityQueryManager::addComponent(EntityQueryImpl query, TypeID type)
+{
+    std::vector<Archetype*> archetypes;
+    this->getMatchingArchetypes(query, archetypes);
+    uint32_t changed = 0;
+    for (Archetype *archetype:archetypes)
+        changed += this->ecs->addComponent(archetype, type);
+    // chunk lists changed, cached chunks of the affected queries are rebuilt on next use
+    this->ecs->cleanChangeList();
+    return changed;
+}
+uint32_t EntityQueryManager::removeComponent(EntityQueryImpl query, TypeID type)
+{
+    std::vector<Archetype*> archetypes;
+    this->getMatchingArchetypes(query, archetypes);
+    uint32_t changed = 0;
+    for (Archetype *archetype:archetypes)
+        changed += this->ecs->removeComponent(archetype, type);
+    this->ecs->cleanChangeList();
+    return changed;
+}
 EntityQueryData* EntityQueryImpl::getData()
 {
     if(!queryData)
@@ -237,18 +350,32 @@ void EntityQueryManager::rebuildMatchingChunkCache(EntityQueryData &query){
         query.cache = std::make_unique<EntityQueryData::ChunkCache[]>(total_count);
     }
     caches = query.cache.get();
-    total_count=0;
+    // group chunks by NUMA node so workers can pick the chunks of their own node
+    uint32_t nodeCursor[Constants::MaximumNodeCount + 1] = {};
+    archetypeCount = query.archetypesCount;
+    while(archetypeCount){
+        archetypeCount--;
+        const Archetype *archetype = archs[archetypeCount];
+        if (archetype->entityCount > 0)
+            for (const Chunk *v:archetype->getChunks())
+                nodeCursor[v->node + 1]++;
+    }
+    query.nodeCount = 1;
+    for (uint32_t n = 0; n < Constants::MaximumNodeCount; n++){
+        if (nodeCursor[n + 1])
+            query.nodeCount = n + 1;
+        nodeCursor[n + 1] += nodeCursor[n];
+    }
+    memcpy(query.nodeBegin, nodeCursor, sizeof(nodeCursor));
+    total_count = nodeCursor[Constants::MaximumNodeCount];
     archetypeCount = query.archetypesCount;
     while(archetypeCount){
         archetypeCount--;
         const Archetype *archetype = archs[archetypeCount];
         const_span<ECS::Chunk*> chunks = archetype->getChunks();
         if (archetype->entityCount > 0)
-            for (const Chunk *v:chunks){
-                *caches = EntityQueryData::ChunkCache{v, archetypeCount};
-                total_count++;
-                caches++;
-            }
+            for (const Chunk *v:chunks)
+                caches[nodeCursor[v->node]++] = EntityQueryData::ChunkCache{v, archetypeCount};
     }
     query.cacheCount = total_count;
     query.validCache = 1;
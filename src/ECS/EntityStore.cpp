@@ -1,6 +1,25 @@
 #include "ECS/EntityStore.hpp"
+#include "ECS/ChunkStore.hpp"
+#include "cutil/HashHelper.hpp"
 using namespace ECS;
 
+inline Chunk* EntityStore::resolve(PackedEntityInChunk entityInChunk)
+{
+    // an invalid index is out of the ChunkStore range
+    return this->chunkStore ? this->chunkStore->getChunkPointer(entityInChunk.chunk) : nullptr;
+}
+inline EntityStore::PackedEntityInChunk EntityStore::pack(EntityInChunk entityInChunk)
+{
+    PackedEntityInChunk packed;
+    if (entityInChunk.chunk != nullptr)
+        packed.chunk = entityInChunk.chunk->index;
+    packed.indexInChunk = (uint16_t)entityInChunk.indexInChunk;
+    return packed;
+}
+EntityStore::~EntityStore()
+{
+    this->flushReservations();
+}
 void EntityStore::ExistsOrThrow(uint32_t blockIndex, uint32_t indexInBlock) {
     if(blockIndex >= BlockCount)
         throw std::invalid_argument("ExistsOrThrow(): entity does not exists");
@@ -45,7 +64,7 @@ Chunk* EntityStore::getChunkIfExists(Entity entity)
         return nullptr;
     if (/*(entity.version() & 1) == 0 || */block->versions[indexInBlock] != entity.version())
         return nullptr;
-    return block->entityInChunk[indexInBlock].chunk;
+    return resolve(block->entityInChunk[indexInBlock]);
 }
 void EntityStore::setEntityInChunk(Entity entity, EntityInChunk entityInChunk)
 {
@@ -53,7 +72,7 @@ void EntityStore::setEntityInChunk(Entity entity, EntityInChunk entityInChunk)
     uint32_t indexInBlock = entity.index() % EntitiesInBlock;
     ExistsOrThrow(blockIndex, indexInBlock);
     DataBlock* block = dataBlocks[blockIndex].get();
-    ((EntityInChunk*)block->entityInChunk)[indexInBlock] = entityInChunk;
+    block->entityInChunk[indexInBlock] = pack(entityInChunk);
 }
 void EntityStore::setEntityVersion(Entity entity, uint32_t version)
 {
@@ -69,16 +88,26 @@ EntityInChunk EntityStore::getEntityInChunk(Entity entity)
     uint32_t indexInBlock = entity.index() % EntitiesInBlock;
     ExistsOrThrow(blockIndex, indexInBlock);
     DataBlock* block = dataBlocks[blockIndex].get();
-    return block->entityInChunk[indexInBlock];
+    const PackedEntityInChunk packed = block->entityInChunk[indexInBlock];
+    EntityInChunk entityInChunk;
+    entityInChunk.chunk = resolve(packed);
+    entityInChunk.indexInChunk = packed.indexInChunk;
+    return entityInChunk;
 }
 void EntityStore::allocateEntities(span<Entity> entities, Chunk *chunk, uint32_t firstEntityInChunkIndex)
 {
+    if (entities.empty())
+        return;
     uint32_t entityInChunkIndex = firstEntityInChunkIndex;
-    /// @brief the current chunk index we are searching for empty slots
-    for (uint32_t i = 0; i < BlockCount; i++)
+    /// @brief the current chunk index we are searching for empty slots, blocks before the hint are full
+    for (uint32_t i = firstFreeBlock.load(); i < BlockCount; i++)
     {
         uint32_t blockCount = entityCount[i].load();
-        if (blockCount == BlockBusy || blockCount == EntitiesInBlock) {continue;}
+        if (blockCount == EntitiesInBlock) {
+            this->skipFullBlock(i);
+            continue;
+        }
+        if (blockCount == BlockBusy) {continue;}
         /// the blocks available entities
         uint32_t blockAvailable = EntitiesInBlock - blockCount;
         /// number of entities to allocate in this block
@@ -98,44 +127,46 @@ void EntityStore::allocateEntities(span<Entity> entities, Chunk *chunk, uint32_t
             block = dataBlocks[i].get();
         }
         // a buffer variable
-        uint32_t remainingCount = std::min(blockAvailable, count);
+        uint32_t remainingCount = count;
         uint32_t* allocated = block->allocated;
         uint32_t* versions = block->versions;
-        EntityInChunk* entityInChunk = block->entityInChunk;
+        PackedEntityInChunk* entityInChunk = block->entityInChunk;
+        const ChunkIndex chunkIndex = chunk != nullptr ? chunk->index : ChunkIndex();
         uint32_t baseEntityIndex = i * EntitiesInBlock;
+        if(baseEntityIndex + EntitiesInBlock - 1 > Constants::MaximumEntityCount)
+            throw std::runtime_error("allocateEntities(): out of entity index");
 
-        while (remainingCount > 0)
-            for (uint32_t maskIndex = 0; maskIndex < EntitiesInBlock / 32; maskIndex++)
-                if (allocated[maskIndex] != ~0UL)
-                {
-                    // There is some space in this one
-                    for (int entity = 0; entity < 32; entity++)
-                    {
-                        uint32_t mask = 1UL << (entity % 32);
-                        if ((allocated[maskIndex] & mask) == 0)
-                        {
-                            uint32_t indexInBlock = maskIndex * 32 + entity;
-                            allocated[maskIndex] |= mask;
-                            uint32_t index = baseEntityIndex + indexInBlock;
-                            if(index > Constants::MaximumEntityCount)
-                                throw std::runtime_error("allocateEntities(): out of entity index");
-                            entities[0] = Entity{(int32_t)index, ++versions[indexInBlock]};
-                            if (chunk != nullptr)
-                                entityInChunk[indexInBlock] = EntityInChunk{chunk,entityInChunkIndex};
-                            else
-                                entityInChunk[indexInBlock] = EntityInChunk();
-                            ++entities;
-                            entityInChunkIndex++;
-                            remainingCount--;
-                            if (remainingCount == 0)
-                                break;
-                        }
-                    }
-                    if (remainingCount == 0)
-                        break;
+        for (uint32_t maskIndex = 0; maskIndex < EntitiesInBlock / 32 && remainingCount != 0; maskIndex++)
+        {
+            uint32_t free = ~allocated[maskIndex];
+            // take whole runs of free slots, a fresh word is a single run of 32
+            while (free != 0 && remainingCount != 0)
+            {
+                const uint32_t start = countTrailingZeros(free);
+                // the zero extended upper half stops the count at the top of the word
+                const uint32_t runLength = std::min(countTrailingZeros(~(uint64_t)(free >> start)), remainingCount);
+                const uint32_t runMask = (runLength == 32 ? ~0U : ((1U << runLength) - 1)) << start;
+                allocated[maskIndex] |= runMask;
+                free &= ~runMask;
+                const uint32_t indexInBlock = maskIndex * 32 + start;
+                for (uint32_t e = 0; e < runLength; e++)
+                    entities[e] = Entity{(int32_t)(baseEntityIndex + indexInBlock + e), ++versions[indexInBlock + e]};
+                for (uint32_t e = 0; e < runLength; e++){
+                    entityInChunk[indexInBlock + e].chunk = chunkIndex;
+                    entityInChunk[indexInBlock + e].indexInChunk = (uint16_t)(entityInChunkIndex + e);
                 }
+                entities += runLength;
+                entityInChunkIndex += runLength;
+                remainingCount -= runLength;
+            }
+        }
         if(0 != remainingCount)
             throw std::runtime_error("AllocateEntities()");
+        if (blockCount + count == EntitiesInBlock){
+            // still holding the block, no deallocation can slip in between
+            uint32_t hint = i;
+            firstFreeBlock.compare_exchange_strong(hint, i + 1);
+        }
         buffer = BlockBusy;
         if(!entityCount[i].compare_exchange_weak(buffer, blockCount + count))
             throw std::runtime_error("AllocateEntities()");
@@ -144,6 +175,85 @@ void EntityStore::allocateEntities(span<Entity> entities, Chunk *chunk, uint32_t
     }
     throw std::runtime_error("AllocateEntities(): could not find a data block for entity allocation.");
 }
+void EntityStore::skipFullBlock(uint32_t blockIndex)
+{
+    if (firstFreeBlock.load() != blockIndex)
+        return;
+    // lock the block so a concurrent deallocation lowers the hint after we raised it
+    uint32_t buffer = EntitiesInBlock;
+    if (!entityCount[blockIndex].compare_exchange_strong(buffer, BlockBusy))
+        return;
+    uint32_t hint = blockIndex;
+    firstFreeBlock.compare_exchange_strong(hint, blockIndex + 1);
+    buffer = BlockBusy;
+    if (!entityCount[blockIndex].compare_exchange_strong(buffer, EntitiesInBlock))
+        throw std::runtime_error("skipFullBlock()");
+}
+EntityStore::ReservationCache& EntityStore::threadReservationCache()
+{
+    static std::atomic<uint32_t> threadCounter{0};
+    thread_local const uint32_t threadOrdinal = threadCounter.fetch_add(1, std::memory_order_relaxed);
+    return this->reservationCaches[threadOrdinal % ReservationCacheCount];
+}
+void EntityStore::reserveEntities(span<Entity> entities)
+{
+    if (entities.size() < ReservationCacheSize)
+    {
+        ReservationCache &cache = threadReservationCache();
+        uint32_t expected = 0;
+        // a contended cache is skipped rather than waited on
+        if (cache.busy.compare_exchange_strong(expected, 1, std::memory_order_acquire))
+        {
+            try {
+                if (cache.count < entities.size())
+                {
+                    // refill behind what is left, the leftovers are handed out first
+                    this->allocateEntities({cache.entities + cache.count, ReservationCacheSize - cache.count});
+                    cache.count = ReservationCacheSize;
+                }
+            } catch(...) {
+                cache.busy.store(0, std::memory_order_release);
+                throw;
+            }
+            cache.count -= entities.size();
+            memcpy(entities.data(), cache.entities + cache.count, entities.size() * sizeof(Entity));
+            cache.busy.store(0, std::memory_order_release);
+            this->markReserved(entities);
+            return;
+        }
+    }
+    this->allocateEntities(entities);
+    this->markReserved(entities);
+}
+void EntityStore::markReserved(const_span<Entity> entities)
+{
+    // the ids belong to the calling thread alone, their slots can be written without holding the block
+    for (uint32_t i = 0; i < entities.size(); i++)
+        dataBlocks[entities[i].index() / EntitiesInBlock]->entityInChunk[entities[i].index() % EntitiesInBlock].chunk = ReservedChunk;
+}
+void EntityStore::flushReservations()
+{
+    for (ReservationCache &cache:this->reservationCaches)
+    {
+        if (cache.count == 0)
+            continue;
+        this->deallocateEntities({cache.entities, cache.count});
+        cache.count = 0;
+    }
+}
+bool EntityStore::isReserved(Entity entity)
+{
+    uint32_t blockIndex   = entity.index() / EntitiesInBlock;
+    uint32_t indexInBlock = entity.index() % EntitiesInBlock;
+    if(blockIndex >= BlockCount)
+        return false;
+    DataBlock* block = dataBlocks[blockIndex].get();
+    if (block == nullptr)
+        return false;
+    return (block->allocated[indexInBlock / 32] & (1U << (indexInBlock % 32))) != 0 &&
+        block->versions[indexInBlock] == entity.version() &&
+        (uint32_t)block->entityInChunk[indexInBlock].chunk == ReservedChunk;
+}
 void EntityStore::deallocateEntities(span<Entity> entities)
 {
     for (uint32_t i = 0; i < entities.size();)
@@ -209,43 +319,197 @@ void EntityStore::deallocateEntities(span<Entity> entities)
 
         uint32_t* allocated = block->allocated;
         uint32_t* versions = block->versions;
+        // names go while the block is held, once released the indices may be allocated and named again
+        const bool removeNames = hasNames.load(std::memory_order_acquire);
+        if (removeNames)
+            this->lockNames();
 
-        for (uint32_t j = startIndex, indexInEntitiesArray = rangeStart; j < endIndex; j++, indexInEntitiesArray++)
+        // the range is contiguous, clear the allocation bits a whole word at a time
+        for (uint32_t j = startIndex, indexInEntitiesArray = rangeStart; j < endIndex;)
         {
-            uint32_t indexInBlock = j % EntitiesInBlock;
-            if (versions[indexInBlock] == entities[indexInEntitiesArray].version())
+            const uint32_t maskIndex = (j % EntitiesInBlock) / 32;
+            uint32_t mask = 0;
+            for (; j < endIndex && (j % EntitiesInBlock) / 32 == maskIndex; j++, indexInEntitiesArray++)
             {
+                uint32_t indexInBlock = j % EntitiesInBlock;
                 // Matching versions confirm that we are deallocating the intended entity
-                uint32_t mask = 1UL << (indexInBlock % 32);
-                versions[indexInBlock]++;
-                allocated[indexInBlock / 32] &= ~0UL ^ mask;
-                blockCount--;
+                if (versions[indexInBlock] == entities[indexInEntitiesArray].version())
+                {
+                    versions[indexInBlock]++;
+                    mask |= 1U << (indexInBlock % 32);
+                    if (removeNames)
+                        this->removeName(j);
+                }
             }
+            allocated[maskIndex] &= ~mask;
+            blockCount -= countSetBits(mask);
         }
+        if (removeNames)
+            this->unlockNames();
         // Do not deallocate the block even if it's empty. Versions should be preserved.
         {
             uint32_t buffer = BlockBusy;
             if (!entityCount[blockIndex].compare_exchange_weak(buffer, blockCount))
                 throw std::runtime_error("DeallocateEntities()");
         }
+        // the block has free slots again, move the allocation hint back to it
+        for (uint32_t hint = firstFreeBlock.load(); hint > blockIndex;)
+            if (firstFreeBlock.compare_exchange_weak(hint, blockIndex))
+                break;
+    }
+}
+#pragma region Names
+namespace
+{
+    inline Hash32 getNameHash(const EntityName &name) {
+        return HashHelper::FNV1A32(name.value, sizeof(name.value));
+    }
+} // namespace
+void EntityStore::NameTable::link(uint32_t slot)
+{
+    const Hash32 hash = getNameHash(this->names[slot]);
+    const int32_t offset = this->heads.indexOf(hash);
+    if (offset < 0) {
+        this->next[slot] = ChainEnd;
+        this->heads.insert(hash, slot);
+        return;
+    }
+    // the set can not update a value in place, new slots go right after the head
+    const uint32_t head = this->heads.getValue(offset);
+    this->next[slot] = this->next[head];
+    this->next[head] = slot;
+}
+void EntityStore::NameTable::unlink(uint32_t slot)
+{
+    const Hash32 hash = getNameHash(this->names[slot]);
+    const int32_t offset = this->heads.indexOf(hash);
+    if (offset < 0)
+        throw std::runtime_error("unlink(): name is not indexed");
+    uint32_t current = this->heads.getValue(offset);
+    if (current == slot) {
+        this->heads.remove(hash);
+        if (this->next[slot] != ChainEnd)
+            this->heads.insert(hash, this->next[slot]);
+        return;
+    }
+    while (this->next[current] != slot) {
+        current = this->next[current];
+        if (current == ChainEnd)
+            throw std::runtime_error("unlink(): name is not indexed");
     }
+    this->next[current] = this->next[slot];
+}
+void EntityStore::lockNames()
+{
+    uint32_t expected = 0;
+    while (!nameLock.compare_exchange_weak(expected, 1, std::memory_order_acquire)) {
+        expected = 0;
+        while (nameLock.load(std::memory_order_relaxed) != 0)
+            ;
+    }
+}
+void EntityStore::unlockNames()
+{
+    nameLock.store(0, std::memory_order_release);
 }
 const EntityName* EntityStore::getEntityName(Entity entity)
 {
     uint32_t blockIndex   = entity.index() / EntitiesInBlock;
     uint32_t indexInBlock = entity.index() % EntitiesInBlock;
     ExistsOrThrow(blockIndex, indexInBlock);
-    DataBlock* block = dataBlocks[blockIndex].get();
-    return &block->names[indexInBlock];
+    if (!hasNames.load(std::memory_order_acquire))
+        return EntityName::Null();
+    const EntityName *result = EntityName::Null();
+    this->lockNames();
+    const int32_t offset = this->nameTable->slots.indexOf(getNameKey(entity.index()));
+    if (offset >= 0)
+        result = &this->nameTable->names[this->nameTable->slots.getValue(offset)];
+    this->unlockNames();
+    return result;
 }
-void EntityStore::setEntityName(Entity entity, EntityName* name)
+void EntityStore::setEntityName(Entity entity, const EntityName* name)
 {
     uint32_t blockIndex   = entity.index() / EntitiesInBlock;
     uint32_t indexInBlock = entity.index() % EntitiesInBlock;
     ExistsOrThrow(blockIndex, indexInBlock);
-    DataBlock* block = dataBlocks[blockIndex].get();
-    if(name != nullptr)
-        memcpy(block->names + indexInBlock, name, sizeof(EntityName));
-    else
-        memset(block->names + indexInBlock, 0, sizeof(EntityName));
-}
\ No newline at end of file
+    if (name == nullptr) {
+        if (!hasNames.load(std::memory_order_acquire))
+            return;
+        this->lockNames();
+        this->removeName(entity.index());
+        this->unlockNames();
+        return;
+    }
+    this->lockNames();
+    try {
+        if (this->nameTable == nullptr) {
+            this->nameTable = std::make_unique<NameTable>();
+            hasNames.store(true, std::memory_order_release);
+        }
+        this->insertName(entity.index(), *name);
+    } catch(...) {
+        this->unlockNames();
+        throw;
+    }
+    this->unlockNames();
+}
+void EntityStore::insertName(uint32_t index, const EntityName &name)
+{
+    NameTable &table = *this->nameTable;
+    const Hash32 key = getNameKey(index);
+    const int32_t offset = table.slots.indexOf(key);
+    if (offset >= 0) {
+        const uint32_t slot = table.slots.getValue(offset);
+        table.unlink(slot);
+        table.names[slot] = name;
+        table.link(slot);
+        return;
+    }
+    uint32_t slot;
+    if (!table.freeSlots.empty()) {
+        slot = table.freeSlots.back();
+        table.freeSlots.pop_back();
+        table.names[slot] = name;
+        table.owners[slot] = index;
+    } else {
+        slot = (uint32_t)table.names.size();
+        table.names.push_back(name);
+        table.owners.push_back(index);
+        table.next.push_back(NameTable::ChainEnd);
+    }
+    table.slots.insert(key, slot);
+    table.link(slot);
+}
+Entity EntityStore::findEntityByName(const EntityName &name)
+{
+    if (!hasNames.load(std::memory_order_acquire))
+        return Entity();
+    Entity result = Entity();
+    this->lockNames();
+    const NameTable &table = *this->nameTable;
+    const int32_t offset = table.heads.indexOf(getNameHash(name));
+    if (offset >= 0)
+        for (uint32_t slot = table.heads.getValue(offset); slot != NameTable::ChainEnd; slot = table.next[slot])
+            if (memcmp(&table.names[slot], &name, sizeof(EntityName)) == 0) {
+                const uint32_t index = table.owners[slot];
+                result = Entity{(int32_t)index, dataBlocks[index / EntitiesInBlock]->versions[index % EntitiesInBlock]};
+                break;
+            }
+    this->unlockNames();
+    return result;
+}
+void EntityStore::removeName(uint32_t index)
+{
+    if (this->nameTable == nullptr)
+        return;
+    NameTable &table = *this->nameTable;
+    const Hash32 key = getNameKey(index);
+    const int32_t offset = table.slots.indexOf(key);
+    if (offset < 0)
+        return;
+    const uint32_t slot = table.slots.getValue(offset);
+    table.unlink(slot);
+    table.freeSlots.push_back(slot);
+    table.slots.remove(key);
+}
+#pragma endregion Names
@@ -3,6 +3,7 @@
 #include "ECS/EntityComponentStore.hpp"
 #include "ECS/ThreadPool.hpp"
 #include "ECS/ComponentDependencyManager.hpp"
+#include "ECS/Archetype.hpp"
 
 using namespace ECS;
 JobHandle JobChunkWrapperBase::schedule(EntityQueryImpl _query,ComponentDependencyManager &cdm){
@@ -27,10 +28,18 @@ JobHandle JobChunkWrapperBase::scheduleParallel(EntityQueryImpl _query,Component
     param.context = this;
     param.dependsOn = dependsOn;
     param.function = &execute;
+    if(this->query->nodeCount > 1){
+        param.nodeBatchBegin = this->query->nodeBegin;
+        param.nodeCount = this->query->nodeCount;
+    }
     JobHandle handle = JobsUtility::schedule(param);
     cdm.addDependency(handle,*this->query); 
     return handle;
 }
+void JobChunkWrapperBase::run(EntityQueryImpl _query){
+    this->query = _query.getData();
+    execute(this, 0, this->query->cacheCount);
+}
 void JobChunkWrapperBase::execute(void *j, uint32_t from, uint32_t to){
     JobChunkWrapperBase          *base = reinterpret_cast<JobChunkWrapperBase*>(j);
     const EntityQueryData        *query = base->query;
@@ -39,7 +48,25 @@ void JobChunkWrapperBase::execute(void *j, uint32_t from, uint32_t to){
     const uint32_t                typesCount = query->firstNoneIndex;
     const EntityQueryData::ChunkCache *cacheFrom = query->cache.get() + from;
     const EntityQueryData::ChunkCache *cacheTo = query->cache.get() + std::min<uint32_t>(to,cacheCount);
+    // two stages: headers are fetched one chunk earlier than the columns they locate
+    const uint32_t headerDistance = prefetchDistance;
+    const uint32_t columnDistance = headerDistance > 1 ? headerDistance - 1 : headerDistance;
+    for(uint32_t i = 1; i < headerDistance && cacheFrom + i < cacheTo; i++)
+        prefetch(cacheFrom[i].value);
     while(cacheFrom < cacheTo){
+        if(headerDistance){
+            if(cacheFrom + headerDistance < cacheTo)
+                prefetch(cacheFrom[headerDistance].value);
+            if(cacheFrom + columnDistance < cacheTo){
+                // first cache line of every queried column, reads the already prefetched header
+                const Chunk *chunk = cacheFrom[columnDistance].value;
+                const Archetype *archetype = chunk->archetype;
+                const int32_t *indices = typesIndex + (typesCount * cacheFrom[columnDistance].archetypeIndex);
+                for(uint32_t t = 0; t < typesCount; t++)
+                    if(indices[t] >= 0)
+                        prefetch(archetype->getColumn(chunk, (uint32_t)indices[t]));
+            }
+        }
         base->execute(
             cacheFrom->value,
             const_span<int32_t>{typesIndex + (typesCount * cacheFrom->archetypeIndex),typesCount}
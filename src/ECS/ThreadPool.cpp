@@ -29,6 +29,8 @@ struct JobData {
     uint32_t batchCount = 1;
     uint32_t batchStepSize = 1;
     uint32_t level = 0;
+    const uint32_t *nodeBatchBegin = NULL;
+    uint32_t nodeCount = 1;
 };
 enum Request : uint32_t {
     Exit = 1,
@@ -57,8 +59,8 @@ alignas(Constants::CacheLineSize) struct ECS::JobDataChunk {
     std::atomic<uint32_t>  capacity = 0;
     std::atomic<uint32_t>  bitmask = 0;
     alignas(Constants::CacheLineSize) uint32_t workCount;
-    /// @brief batch begin index to start with
     align_ptr<JobData[]>   jobs = NULL;
+    /// @brief batch begin index to start with, Constants::MaximumNodeCount per job
     std::atomic<uint32_t>  *beginIndex = NULL;
     /// @brief sorted by dependency. use the handle to find the real index.
     JobHandle              *jobsArray = NULL;
@@ -86,6 +88,12 @@ JobHandle JobsUtility::schedule(const JobParameter& data){
         job.context = data.context;
         job.batchCount = data.batchCount;
         job.batchStepSize = data.batchStepSize;
+        if(data.nodeBatchBegin != NULL && data.nodeCount > 1){
+            if(data.nodeCount > Constants::MaximumNodeCount || data.nodeBatchBegin[data.nodeCount] > data.batchCount)
+                throw std::invalid_argument("schedule(): invalid node batches");
+            job.nodeBatchBegin = data.nodeBatchBegin;
+            job.nodeCount = data.nodeCount;
+        }
         if(data.dependsOn.index() >= 0)
             job.level = sharedData.jobs[data.dependsOn.index()].level + 1;
     }
@@ -98,7 +106,7 @@ void JobDataChunk::prepareJobs(){
     JobData *jobsPtr = sharedData.jobs.get();
     if(count < 1)
         return;
-    memset(sharedData.beginIndex, 0, sizeof(std::atomic<uint32_t>)*count);
+    memset(sharedData.beginIndex, 0, sizeof(std::atomic<uint32_t>)*count*Constants::MaximumNodeCount);
     for(uint32_t i=0;i<count;i++)
         bufferPtr[i] = JobEntry{JobHandle(i), jobsPtr[i].level};
     std::sort(bufferPtr,bufferPtr+count);
@@ -126,7 +134,7 @@ void JobDataChunk::resizeJobPool(uint32_t capacity){
         return;//throw std::invalid_argument("resizeJobPool(): can't resize to smaller array");
     uint32_t size_temp[4];
     size_temp[0] =                sizeof(JobData)  *capacity;
-    size_temp[1] = size_temp[0] + sizeof(std::atomic<uint32_t>)*capacity;
+    size_temp[1] = size_temp[0] + sizeof(std::atomic<uint32_t>)*capacity*Constants::MaximumNodeCount;
     size_temp[2] = size_temp[1] + sizeof(JobHandle)*capacity;
     size_temp[3] = size_temp[2] + sizeof(JobEntry) *capacity;
     align_ptr<JobDataChunk> ptr2{(JobDataChunk*)allocator().allocate(size_temp[3])};
@@ -283,6 +291,8 @@ void iterate_systems(){
         }
     }
     sharedEngine->eqm.updateNewArchetypes();
+    sharedEngine->ecs.defragment();
+    sharedEngine->ecs.collectEmptyArchetypes();
     sharedEngine->ecs.cleanChangeList();
     if(!sharedEngine->scheduleQueue.empty())
     {
@@ -359,6 +369,13 @@ void work_jobs(uv__work *)
 {
     //uv_work_t* arg = (uv_work_t *) ((uint8_t*)(w) - offsetof(uv_work_t, work_req));
     //JobDataChunk &sharedData = *(JobDataChunk*)arg->data;
+    // spread workers over NUMA nodes once, chunks are then handed to the worker of their node
+    static std::atomic<uint32_t> workerCounter{0};
+    thread_local const uint32_t workerNode = [](){
+        const uint32_t node = workerCounter.fetch_add(1) % ChunkStore::getNodeCount();
+        ChunkStore::setThreadNode(node);
+        return node;
+    }();
     while (true)
     {
         uint32_t readIndex = sharedData.readIndex.load();
@@ -367,7 +384,7 @@ void work_jobs(uv__work *)
             return;
 
         JobHandle job = sharedData.jobsArray[readIndex];
-        std::atomic<uint32_t> &beginIndexPtr = sharedData.beginIndex[job.index()];
+        std::atomic<uint32_t> *beginIndexPtr = sharedData.beginIndex + job.index() * Constants::MaximumNodeCount;
         JobData jobData;
         memcpy(&jobData, sharedData.jobs.get() + job.index(), sizeof(JobData));
 
@@ -375,17 +392,42 @@ void work_jobs(uv__work *)
         if(jobData.level > sharedData.readerLevel)
             return;
         // if(likely(jobData.function != NULL)){}
-        while(true)
+        if(jobData.nodeCount <= 1)
+        {
+            while(true)
+            {
+                uint32_t batchBegin = beginIndexPtr->fetch_add(1);
+                if(batchBegin >= jobData.batchCount)
+                    break;
+                batchBegin *= jobData.batchStepSize;
+                jobData.function(
+                    jobData.context,
+                    batchBegin,
+                    batchBegin+jobData.batchStepSize
+                );
+            }
+        }
+        else
         {
-            uint32_t batchBegin = beginIndexPtr.fetch_add(1);
-            if(batchBegin >= jobData.batchCount)
-                break;
-            batchBegin *= jobData.batchStepSize;
-            jobData.function(
-                jobData.context,
-                batchBegin,
-                batchBegin+jobData.batchStepSize
-            );
+            // own node first, then steal from the others
+            for(uint32_t n = 0; n < jobData.nodeCount; n++)
+            {
+                const uint32_t node = (workerNode + n) % jobData.nodeCount;
+                const uint32_t nodeBegin = jobData.nodeBatchBegin[node];
+                const uint32_t nodeEnd = jobData.nodeBatchBegin[node + 1];
+                while(true)
+                {
+                    uint32_t batchBegin = nodeBegin + beginIndexPtr[node].fetch_add(1);
+                    if(batchBegin >= nodeEnd)
+                        break;
+                    batchBegin *= jobData.batchStepSize;
+                    jobData.function(
+                        jobData.context,
+                        batchBegin,
+                        batchBegin+jobData.batchStepSize
+                    );
+                }
+            }
         }
         sharedData.readIndex.compare_exchange_weak(readIndex,readIndex+1);
     }
@@ -0,0 +1,207 @@
+#include "ECS/CopyKernels.hpp"
+#include "ECS/EntityComponentStore.hpp"
+#include "ECS/Archetype.hpp"
+#include "cutil/mini_test.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <random>
+#include <algorithm>
+using namespace ECS;
+
+struct lookup_component : IComponentData
+{
+    float value[4];
+};
+DEF_TYPE(lookup_component)
+// spreads the lookup entities over a few archetypes
+template<uint32_t N>
+struct lookup_tag : IComponentData
+{
+};
+DEF_TYPE(lookup_tag<0>)
+DEF_TYPE(lookup_tag<1>)
+
+// what Archetype::copy did before the kernels, a memcpy of the whole run
+static void copyMemcpy(uint8_t *dst, const uint8_t *src, uint32_t count, uint32_t sizeOf){
+    memcpy(dst, src, (size_t)count * sizeOf);
+}
+
+static double measure(CopyKernel kernel, uint8_t *dst, const uint8_t *src, uint32_t sizeOf, uint32_t count, uint32_t capacity, uint32_t repeat){
+    const auto begin = std::chrono::steady_clock::now();
+    // walk the columns like consecutive moves do
+    uint32_t index = 0;
+    for(uint32_t r = 0; r < repeat; r++){
+        kernel(dst + (size_t)index * sizeOf, src + (size_t)index * sizeOf, count, sizeOf);
+        index += count;
+        if(index + count > capacity)
+            index = 0;
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / repeat;
+}
+
+TEST(CopyKernelsCorrectness) {
+    const uint32_t sizes[] = {1, 2, 3, 4, 8, 12, 16, 20, 24, 32, 48, 64, 96};
+    const uint32_t counts[] = {0, 1, 2, 7, 64, 1000, 4096};
+    for(uint32_t sizeOf:sizes){
+        CopyKernel kernel = CopyKernels::select(sizeOf);
+        for(uint32_t count:counts){
+            // odd offsets, the streaming path has to handle unaligned heads and tails
+            std::vector<uint8_t> src((size_t)count * sizeOf + 3), dst((size_t)count * sizeOf + 5, 0xAB);
+            for(size_t i = 0; i < src.size(); i++)
+                src[i] = (uint8_t)(i * 7 + 1);
+            kernel(dst.data() + 1, src.data() + 3, count, sizeOf);
+            EXPECT_EQ(memcmp(dst.data() + 1, src.data() + 3, (size_t)count * sizeOf), 0);
+            // nothing written out of range
+            EXPECT_EQ(dst[0], 0xAB);
+            for(size_t i = (size_t)count * sizeOf + 1; i < dst.size(); i++)
+                EXPECT_EQ(dst[i], 0xAB);
+        }
+    }
+}
+
+static void copyStreaming(uint8_t *dst, const uint8_t *src, uint32_t count, uint32_t sizeOf){
+    CopyKernels::copyStreaming(dst, src, (size_t)count * sizeOf);
+}
+
+TEST(CopyKernelsBenchmark) {
+    // MAGIC NUMBER, a bit more than the largest chunk column
+    const uint32_t hotSize = 128 * 1024;
+    std::vector<uint8_t> src(hotSize), dst(hotSize);
+    for(uint32_t i = 0; i < hotSize; i++)
+        src[i] = (uint8_t)i;
+    // single entity moves and small batches, 20 bytes has no specialization
+    const uint32_t sizes[] = {4, 8, 12, 16, 24, 32, 64, 20};
+    const uint32_t counts[] = {1, 4, 16};
+    for(uint32_t sizeOf:sizes){
+        for(uint32_t count:counts){
+            // MAGIC NUMBER, roughly constant number of bytes per measurement
+            const uint32_t repeat = (64u << 20) / (count * sizeOf) + 1;
+            // volatile, the compiler must not inline either side
+            CopyKernel volatile baseline = copyMemcpy;
+            CopyKernel volatile kernel = CopyKernels::select(sizeOf);
+            const double a = measure(baseline, dst.data(), src.data(), sizeOf, count, hotSize / sizeOf, repeat);
+            const double b = measure(kernel, dst.data(), src.data(), sizeOf, count, hotSize / sizeOf, repeat);
+            EXPECT_EQ(memcmp(dst.data(), src.data(), (size_t)count * sizeOf), 0);
+            printf("size %2u x %2u: memcpy %7.2f ns, kernel %7.2f ns (%.2fx)\n", sizeOf, count, a, b, a / b);
+        }
+    }
+}
+
+TEST(StreamingCopyBenchmark) {
+    // whole column of the largest chunk, once within cache and once walking a buffer larger than the last level cache
+    const uint32_t column = 64 * 1024;
+    // MAGIC NUMBER, larger than the last level cache
+    const uint32_t coldSize = 64u << 20;
+    std::vector<uint8_t> src(coldSize), dst(coldSize);
+    for(uint32_t i = 0; i < coldSize; i++)
+        src[i] = (uint8_t)i;
+    const uint32_t workingSets[] = {2 * column, coldSize};
+    for(uint32_t workingSet:workingSets){
+        const uint32_t repeat = 2 * coldSize / column;
+        CopyKernel volatile baseline = copyMemcpy;
+        CopyKernel volatile streaming = copyStreaming;
+        const double a = measure(baseline, dst.data(), src.data(), 1, column, workingSet, repeat);
+        const double b = measure(streaming, dst.data(), src.data(), 1, column, workingSet, repeat);
+        EXPECT_EQ(memcmp(dst.data(), src.data(), workingSet), 0);
+        printf("%6u KB working set: memcpy %9.2f ns, streaming %9.2f ns (%.2fx)\n", workingSet / 1024, a, b, a / b);
+    }
+}
+
+// the EntityStore data block before EntityInChunk was packed, a chunk pointer and an index per entity
+struct UnpackedDataBlock
+{
+    // MAGIC NUMBER, EntityStore::EntitiesInBlock
+    static constexpr uint32_t EntitiesInBlock = 8192;
+    uint32_t allocated[EntitiesInBlock / 32];
+    EntityInChunk entityInChunk[EntitiesInBlock];
+    uint32_t versions[EntitiesInBlock];
+};
+// what EntityStore::getEntityInChunk did with the unpacked blocks, out of line like the real one
+__attribute__((noinline)) static EntityInChunk getUnpackedEntityInChunk(UnpackedDataBlock *const *blocks, Entity entity){
+    const uint32_t blockIndex = entity.index() / UnpackedDataBlock::EntitiesInBlock;
+    const uint32_t indexInBlock = entity.index() % UnpackedDataBlock::EntitiesInBlock;
+    const UnpackedDataBlock *block = blocks[blockIndex];
+    if(block == nullptr || (block->allocated[indexInBlock / 32] & (1U << (indexInBlock % 32))) == 0)
+        throw std::invalid_argument("getUnpackedEntityInChunk(): entity does not exists");
+    return block->entityInChunk[indexInBlock];
+}
+
+class Test {
+public:
+    static void RandomLookupBenchmark();
+};
+
+CLASS_TEST(Test,RandomLookupBenchmark) {
+    // MAGIC NUMBER, per archetype, a single one can not hold much more (chunk list allocation limit)
+    const uint32_t archetypeSize = 1u << 20;
+    // MAGIC NUMBER, a packed table (~1.6 MB) that fits a 2 MB L2 while the unpacked one (~2.5 MB) does not,
+    // and a table far past L2 where both fit a large L3 and the extra chunk table load shows
+    const uint32_t counts[] = {1u << 17, 1u << 21};
+    const TypeID type = getTypeID<lookup_component>();
+    for(uint32_t count:counts){
+        std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+        Archetype *archetypes[] = {
+            ecs->getOrCreateArchetype(componentTypes<Entity,lookup_component,lookup_tag<0>>()),
+            ecs->getOrCreateArchetype(componentTypes<Entity,lookup_component,lookup_tag<1>>())
+        };
+        std::vector<Entity> entities(count);
+        std::vector<lookup_component> values(std::min(count, archetypeSize));
+        for(uint32_t i = 0; i < values.size(); i++)
+            values[i].value[0] = (float)(i & 0xFF);
+        const ComponentColumn column = {type, values.data()};
+        double expected = 0;
+        for(uint32_t first = 0, a = 0; first < count; first += (uint32_t)values.size(), a++){
+            ecs->createEntities(archetypes[a], {entities.data() + first, (uint32_t)values.size()}, {&column, 1});
+            for(const lookup_component &value:values)
+                expected += value.value[0];
+        }
+        // the same entities in the old layout
+        std::vector<std::unique_ptr<UnpackedDataBlock>> unpacked;
+        std::vector<UnpackedDataBlock*> blocks;
+        for(Entity entity:entities){
+            const uint32_t blockIndex = entity.index() / UnpackedDataBlock::EntitiesInBlock;
+            const uint32_t indexInBlock = entity.index() % UnpackedDataBlock::EntitiesInBlock;
+            while(unpacked.size() <= blockIndex){
+                unpacked.push_back(std::make_unique<UnpackedDataBlock>());
+                blocks.push_back(unpacked.back().get());
+            }
+            blocks[blockIndex]->allocated[indexInBlock / 32] |= 1U << (indexInBlock % 32);
+            blocks[blockIndex]->entityInChunk[indexInBlock] = ecs->getEntityInChunk(entity);
+            blocks[blockIndex]->versions[indexInBlock] = entity.version();
+        }
+        std::shuffle(entities.begin(), entities.end(), std::mt19937(42));
+        // both do what getComponentDataWithTypeRO does after the entity lookup, alternating to cancel drift
+        std::vector<double> packedTimes, unpackedTimes;
+        // MAGIC NUMBER
+        for(uint32_t round = 0; round < 6; round++){
+            const bool packed = round % 2 == 0;
+            double sum = 0;
+            const auto begin = std::chrono::steady_clock::now();
+            if(packed)
+                for(Entity entity:entities){
+                    const EntityInChunk entityInChunk = ecs->getEntityInChunk(entity);
+                    sum += ((const lookup_component*)ecs->getArchetype(entityInChunk.chunk)->getComponentDataWithTypeRO(entityInChunk.chunk, entityInChunk.indexInChunk, type))->value[0];
+                }
+            else
+                for(Entity entity:entities){
+                    const EntityInChunk entityInChunk = getUnpackedEntityInChunk(blocks.data(), entity);
+                    sum += ((const lookup_component*)ecs->getArchetype(entityInChunk.chunk)->getComponentDataWithTypeRO(entityInChunk.chunk, entityInChunk.indexInChunk, type))->value[0];
+                }
+            const auto end = std::chrono::steady_clock::now();
+            EXPECT_EQ(sum, expected);
+            (packed ? packedTimes : unpackedTimes).push_back(std::chrono::duration<double, std::nano>(end - begin).count() / count);
+        }
+        std::sort(packedTimes.begin(), packedTimes.end());
+        std::sort(unpackedTimes.begin(), unpackedTimes.end());
+        const double a = packedTimes[packedTimes.size() / 2], b = unpackedTimes[unpackedTimes.size() / 2];
+        printf("random lookup over %7u entities: packed %6.2f ns, unpacked %6.2f ns (%.2fx)\n", count, a, b, b / a);
+        ecs->destroyEntities({entities.data(), count});
+    }
+}
+
+int main(){mtest::run_all();return 0;}
@@ -0,0 +1,1037 @@
+#include "ECS/ChunkStore.hpp"
+#include "ECS/EntityComponentStore.hpp"
+#include "ECS/Archetype.hpp"
+#include "ECS/Base/AoSoA.hpp"
+#include "ECS/EntityQueryManager.hpp"
+#include "ECS/JobChunk.hpp"
+#include "ECS/EntityStore.hpp"
+#include "cutil/mini_test.hpp"
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <thread>
+
+struct large_component : ECS::IComponentData
+{
+    uint8_t data[200];
+};
+template<> ECS::TypeID ECS::__typeid__<large_component>(){
+    static ECS::TypeID v = ECS::TypeManager::registerType<large_component>("large_component");
+    return v;
+}
+
+struct alignas(128) wide_component : ECS::IComponentData
+{
+    float data[8];
+};
+template<> ECS::TypeID ECS::__typeid__<wide_component>(){
+    static ECS::TypeID v = ECS::TypeManager::registerType<wide_component>("wide_component");
+    return v;
+}
+struct odd_component : ECS::IComponentData
+{
+    uint8_t data[3];
+};
+template<> ECS::TypeID ECS::__typeid__<odd_component>(){
+    static ECS::TypeID v = ECS::TypeManager::registerType<odd_component>("odd_component");
+    return v;
+}
+struct aosoa_vector : ECS::IComponentData
+{
+    float x, y, z;
+};
+DEF_TYPE_AOSOA(aosoa_vector)
+struct cold_component : ECS::IComponentData
+{
+    uint8_t data[200];
+};
+DEF_TYPE_COLD(cold_component)
+struct transition_tag : ECS::IComponentData
+{
+};
+DEF_TYPE(transition_tag)
+struct default_component : ECS::IComponentData
+{
+    float value = 2.5f;
+    uint32_t flags = 7;
+};
+DEF_TYPE(default_component)
+struct default_vector : ECS::IComponentData
+{
+    float x = 1.0f, y = 0.0f, z = -1.0f;
+};
+DEF_TYPE_AOSOA(default_vector)
+// breaks if moved with memcpy, counts live instances
+struct tracked_component : ECS::IComponentData, ECS::IManagedComponentData
+{
+    static int32_t live;
+    tracked_component *self;
+    uint32_t value = 0;
+    tracked_component():self{this}{live++;}
+    tracked_component(tracked_component &&other):self{this},value{other.value}{live++;}
+    ~tracked_component(){live--;}
+};
+int32_t tracked_component::live = 0;
+DEF_TYPE(tracked_component)
+// combined into many archetypes
+template<uint32_t N>
+struct combo_component : ECS::IComponentData
+{
+    uint32_t value;
+};
+DEF_TYPE(combo_component<0>)
+DEF_TYPE(combo_component<1>)
+DEF_TYPE(combo_component<2>)
+DEF_TYPE(combo_component<3>)
+DEF_TYPE(combo_component<4>)
+DEF_TYPE(combo_component<5>)
+DEF_TYPE(combo_component<6>)
+DEF_TYPE(combo_component<7>)
+DEF_TYPE(combo_component<8>)
+DEF_TYPE(combo_component<9>)
+
+class Test {
+public:
+    static void ArchetypeTransitions();
+    static void ArchetypeMetadata();
+    static void ArchetypeCollector();
+};
+
+TEST(SlabRecycle) {
+    using namespace ECS;
+    std::unique_ptr<ChunkStore> store = std::make_unique<ChunkStore>();
+    std::vector<ChunkIndex> indices;
+    const uint32_t chunksPerSlab = ChunkStore::getChunksPerSlab(1);
+    for(uint32_t i = 0;i < chunksPerSlab + 1;i++)
+        indices.push_back(store->allocateChunk(1));
+    EXPECT_EQ(store->getSlabCount(), 2u);
+    EXPECT_EQ(store->getFreeMemory(), (size_t)(chunksPerSlab - 1) * Chunk::getMemorySize(1));
+    Chunk *first = store->getChunkPointer(indices[0]);
+    EXPECT_EQ(((uintptr_t)first) % Constants::CacheLineSize, 0u);
+    store->freeChunk(indices[0]);
+    EXPECT_EQ(store->getChunkPointer(indices[0]) == nullptr, true);
+    // a freed chunk is handed out again before any untouched memory
+    ChunkIndex again = store->allocateChunk(1);
+    EXPECT_EQ(store->getChunkPointer(again) == first, true);
+    EXPECT_EQ(store->getChunkPointer(again)->count, 0u);
+    indices[0] = again;
+    for(ChunkIndex index:indices)
+        store->freeChunk(index);
+    // below the watermark empty slabs stay mapped
+    EXPECT_EQ(store->getSlabCount(), 2u);
+    store->setReleaseWatermark(0);
+    EXPECT_EQ(store->getSlabCount(), 1u);
+}
+
+TEST(SlabHugePages) {
+    using namespace ECS;
+    std::unique_ptr<ChunkStore> store = std::make_unique<ChunkStore>();
+    store->setHugePages(true);
+    ChunkIndex index = store->allocateChunk();
+    Chunk *chunk = store->getChunkPointer(index);
+    EXPECT_NE(chunk, nullptr);
+    chunk->buffer[chunk->bufferSize() - 1] = 1;
+    store->freeChunk(index);
+}
+
+TEST(BitmapIndices) {
+    using namespace ECS;
+    std::unique_ptr<ChunkStore> store = std::make_unique<ChunkStore>();
+    std::vector<ChunkIndex> indices;
+    // spans several bitmap words
+    for(uint32_t i = 0;i < ChunkStore::BitmaskSize * 3;i++)
+        indices.push_back(store->allocateChunk());
+    for(uint32_t i = 0;i < indices.size();i++)
+        EXPECT_EQ((uint32_t)indices[i], i);
+    for(uint32_t i = 0;i < indices.size();i += 2)
+        store->freeChunk(indices[i]);
+    std::vector<bool> used(ChunkStore::BitmaskSize * 4, false);
+    for(uint32_t i = 1;i < indices.size();i += 2)
+        used[indices[i]] = true;
+    // freed indices come back (through the thread cache or the bitmap) before new ones
+    for(uint32_t i = 0;i < indices.size();i += 2){
+        ChunkIndex index = store->allocateChunk();
+        EXPECT_EQ(used[index], false);
+        EXPECT_EQ((uint32_t)index < indices.size(), true);
+        used[index] = true;
+        indices[i] = index;
+    }
+    for(ChunkIndex index:indices)
+        store->freeChunk(index);
+}
+
+TEST(SegmentGrowth) {
+    using namespace ECS;
+    std::unique_ptr<ChunkStore> store = std::make_unique<ChunkStore>();
+    // small worlds only pay for the directory
+    EXPECT_EQ(store->getIndexCapacity(), 0u);
+    std::vector<ChunkIndex> indices;
+    for(uint32_t i = 0;i < ChunkStore::SegmentSize + 1;i++)
+        indices.push_back(store->allocateChunk(0));
+    EXPECT_EQ(store->getIndexCapacity(), ChunkStore::SegmentSize * 2);
+    EXPECT_EQ((uint32_t)indices.back(), ChunkStore::SegmentSize);
+    EXPECT_EQ(store->getChunkPointer(indices.back())->index == indices.back(), true);
+    store->freeChunk(indices[5]);
+    for(uint32_t i = 0;i < ChunkStore::IndexCacheSize;i++)
+        store->freeChunk(indices[indices.size() - 1 - i]);
+    // freed indices are reused before the directory grows again
+    ChunkIndex index = store->allocateChunk(0);
+    EXPECT_EQ((uint32_t)index < ChunkStore::SegmentSize + 1, true);
+    EXPECT_EQ(store->getIndexCapacity(), ChunkStore::SegmentSize * 2);
+    EXPECT_EQ(store->getChunkPointer(ChunkStore::SegmentSize * 2) == nullptr, true);
+}
+
+TEST(SizeClasses) {
+    using namespace ECS;
+    std::unique_ptr<ChunkStore> store = std::make_unique<ChunkStore>();
+    ChunkIndex small = store->allocateChunk(0);
+    ChunkIndex large = store->allocateChunk(Chunk::SizeClassCount - 1);
+    // every class is carved out of its own slabs
+    EXPECT_EQ(store->getSlabCount(), 2u);
+    EXPECT_EQ(store->getChunkPointer(small)->memorySize(), Chunk::getMemorySize(0));
+    EXPECT_EQ(store->getChunkPointer(large)->memorySize(), Chunk::getMemorySize(Chunk::SizeClassCount - 1));
+    store->freeChunk(small);
+    store->freeChunk(large);
+}
+
+TEST(SizeClassPromotion) {
+    using namespace ECS;
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    Archetype *arch = ecs->getOrCreateArchetype(componentTypes<Entity,large_component>());
+    // a rare archetype starts with the smallest chunks
+    EXPECT_EQ(arch->getSizeClass(), 0u);
+    std::vector<Entity> entities(arch->getChunkCapacity((uint32_t)0) * Constants::SizeClassPromotionChunkCount * 8);
+    ecs->createEntities(arch, {entities.data(), (uint32_t)entities.size()});
+    EXPECT_NE(arch->getSizeClass(), 0u);
+    uint32_t total = 0;
+    for(Chunk *chunk:arch->getChunks()){
+        EXPECT_EQ(chunk->count <= arch->getChunkCapacity(chunk), true);
+        total += chunk->count;
+    }
+    EXPECT_EQ(total, (uint32_t)entities.size());
+    EXPECT_EQ(ecs->exists(entities.back()), true);
+    ecs->destroyEntities({entities.data(), (uint32_t)entities.size()});
+}
+
+TEST(Defragment) {
+    using namespace ECS;
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    Archetype *arch = ecs->getOrCreateArchetype(componentTypes<Entity,large_component>());
+    const uint32_t capacity = arch->getChunkCapacity((uint32_t)0);
+    const uint32_t keep = capacity / 3;
+    std::vector<Entity> entities(capacity * 3);
+    ecs->createEntities(arch, {entities.data(), (uint32_t)entities.size()});
+    EXPECT_EQ(arch->getChunks().size(), 3u);
+    for(uint32_t i = 0;i < entities.size();i++)
+        ((large_component*)ecs->getComponentDataWithTypeRW(entities[i], getTypeID<large_component>()))->data[0] = (uint8_t)i;
+    // chunk c keeps (keep - c) entities
+    std::vector<Entity> destroyed, alive;
+    for(uint32_t i = 0;i < entities.size();i++){
+        if(i % capacity < keep - i / capacity)
+            alive.push_back(entities[i]);
+        else
+            destroyed.push_back(entities[i]);
+    }
+    ecs->destroyEntities({destroyed.data(), (uint32_t)destroyed.size()});
+    EXPECT_EQ(arch->getChunks().size(), 3u);
+    // new entities go to the fullest chunk with free slots
+    Entity extra;
+    ecs->createEntities(arch, {&extra, 1});
+    EXPECT_EQ(ecs->exists(extra), true);
+    uint32_t fullest = 0;
+    for(Chunk *chunk:arch->getChunks())
+        fullest = std::max(fullest, chunk->count);
+    EXPECT_EQ(fullest, keep + 1);
+
+    DefragmentStats stats = ecs->defragment();
+    EXPECT_EQ(stats.reclaimedChunks, 2u);
+    EXPECT_EQ(stats.reclaimedBytes, (size_t)Chunk::getMemorySize(0) * 2);
+    EXPECT_EQ(stats.movedEntities, keep * 2 - 3);
+    EXPECT_EQ(arch->getChunks().size(), 1u);
+    EXPECT_EQ(arch->count(), (uint32_t)alive.size() + 1);
+    for(Entity entity:alive){
+        EXPECT_EQ(ecs->exists(entity), true);
+        const large_component *component = (const large_component*)ecs->getComponentDataWithTypeRO(entity, getTypeID<large_component>());
+        uint32_t i = 0;
+        while(entities[i] != entity) i++;
+        EXPECT_EQ(component->data[0], (uint8_t)i);
+    }
+    // nothing left to merge
+    stats = ecs->defragment();
+    EXPECT_EQ(stats.movedEntities, 0u);
+    alive.push_back(extra);
+    ecs->destroyEntities({alive.data(), (uint32_t)alive.size()});
+}
+
+TEST(NumaPools) {
+    using namespace ECS;
+    // simulate a dual socket box
+    ChunkStore::setNodeCount(2);
+    EXPECT_EQ(ChunkStore::getNodeCount(), 2u);
+    {
+        std::unique_ptr<ChunkStore> store = std::make_unique<ChunkStore>();
+        ChunkIndex first = store->allocateChunk(0, 1);
+        ChunkIndex second = store->allocateChunk(0, 0);
+        EXPECT_EQ(store->getChunkPointer(first)->node, 1u);
+        EXPECT_EQ(store->getChunkPointer(second)->node, 0u);
+        // every node has its own slabs
+        EXPECT_EQ(store->getSlabCount(), 2u);
+        ChunkStore::setThreadNode(1);
+        EXPECT_EQ(ChunkStore::getThreadNode(), 1u);
+        ChunkIndex third = store->allocateChunk(0);
+        EXPECT_EQ(store->getChunkPointer(third)->node, 1u);
+        EXPECT_EQ(store->getSlabCount(), 2u);
+        store->freeChunk(first);
+        store->freeChunk(second);
+        store->freeChunk(third);
+    }
+    {
+        std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+        std::unique_ptr<EntityQueryManager> eqm = std::make_unique<EntityQueryManager>(ecs.get());
+        Archetype *arch = ecs->getOrCreateArchetype(componentTypes<Entity,large_component>());
+        const uint32_t capacity = arch->getChunkCapacity((uint32_t)0);
+        std::vector<Entity> entities(capacity * 3);
+        // first and last chunk on node 1, the middle one on node 0
+        ChunkStore::setThreadNode(1);
+        ecs->createEntities(arch, {entities.data(), capacity});
+        ChunkStore::setThreadNode(0);
+        ecs->createEntities(arch, {entities.data() + capacity, capacity});
+        ChunkStore::setThreadNode(1);
+        ecs->createEntities(arch, {entities.data() + capacity * 2, capacity});
+        ChunkStore::setThreadNode(0);
+        EntityQueryBuilder builder;
+        builder.withAll(getTypeID<large_component>());
+        EntityQueryImpl query = eqm->createEntityQuery(builder);
+        EntityQueryData *data = query.getData();
+        const_span<uint32_t> nodeBegin = data->getNodeBegin();
+        EXPECT_EQ(nodeBegin.size(), 3u);
+        EXPECT_EQ(nodeBegin[0], 0u);
+        EXPECT_EQ(nodeBegin[1], 1u);
+        EXPECT_EQ(nodeBegin[2], 3u);
+        ecs->destroyEntities({entities.data(), (uint32_t)entities.size()});
+    }
+    ChunkStore::setNodeCount(0);
+}
+
+TEST(ColumnLayout) {
+    using namespace ECS;
+    EXPECT_EQ(Chunk::getLaneCount(4), 16u);
+    EXPECT_EQ(Chunk::getLaneCount(8), 8u);
+    EXPECT_EQ(Chunk::getLaneCount(12), 16u);
+    EXPECT_EQ(Chunk::getLaneCount(128), 1u);
+    EXPECT_EQ(Chunk::getPaddedCount(17, 4), 32u);
+    EXPECT_EQ(Chunk::getPaddedCount(17, 64), 17u);
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    Archetype *arch = ecs->getOrCreateArchetype(componentTypes<Entity,large_component,wide_component,odd_component>());
+    const_span<TypeID> types = arch->getTypes();
+    const_span<uint16_t> sizes = arch->getSize();
+    for(uint32_t c = 0;c < Chunk::SizeClassCount;c++){
+        const_span<uint32_t> offsets = arch->getOffset(c);
+        const uint32_t capacity = arch->getChunkCapacity(c);
+        for(uint32_t i = 0;i < types.size();i++){
+            const uint32_t alignment = std::max<uint32_t>(TypeManager::GetTypeInfo(types[i]).AlignmentInBytes, Constants::ChunkColumnAlignment);
+            EXPECT_EQ(offsets[i] % alignment, 0u);
+            // padded elements of a column never reach the next one
+            const uint32_t end = offsets[i] + sizes[i] * Chunk::getPaddedCount(capacity, sizes[i]);
+            EXPECT_EQ(end <= (i + 1 < types.size() ? offsets[i + 1] : Chunk::getMemorySize(c)), true);
+        }
+    }
+    Entity entity;
+    ecs->createEntities(arch, {&entity, 1});
+    EXPECT_EQ(((uintptr_t)ecs->getComponentDataWithTypeRO(entity, getTypeID<wide_component>())) % 128, 0u);
+    ecs->destroyEntities({&entity, 1});
+}
+
+TEST(AoSoAStorage) {
+    using namespace ECS;
+    struct unsupported_component : IComponentData { uint8_t data[3]; };
+    EXPECT_EQ(getTypeID<aosoa_vector>().isAoSoA(), true);
+    EXPECT_EQ(getTypeID<large_component>().isAoSoA(), false);
+    bool thrown = false;
+    try { TypeManager::registerType<unsupported_component>("unsupported_component", {}, TypeManager::StorageLayout::AoSoA); }
+    catch(const std::invalid_argument&) { thrown = true; }
+    EXPECT_EQ(thrown, true);
+    EXPECT_EQ(AoSoA::getFieldOffset(9, 2, 12), 96u + 64u + 4u);
+
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    Archetype *arch = ecs->getOrCreateArchetype(componentTypes<Entity,aosoa_vector>());
+    const int32_t indexInTypeArray = arch->getIndexInTypeArray(getTypeID<aosoa_vector>());
+    for(uint32_t c = 0;c < Chunk::SizeClassCount;c++)
+        EXPECT_EQ(arch->getOffset(c)[indexInTypeArray] % Constants::ChunkColumnAlignment, 0u);
+    // MAGIC NUMBER, a few blocks with a partial last one
+    std::vector<Entity> entities(45);
+    ecs->createEntities(arch, {entities.data(), (uint32_t)entities.size()});
+    for(uint32_t i = 0; i < entities.size(); i++){
+        const aosoa_vector value = {{}, (float)i, (float)(2 * i), (float)(3 * i)};
+        ecs->setComponentData(entities[i], getTypeID<aosoa_vector>(), &value);
+    }
+    // rows hold a single field of a block
+    Chunk *chunk = arch->getChunks()[0];
+    AoSoAColumn<const aosoa_vector> column(arch->getComponentDataRO(chunk, 0, indexInTypeArray));
+    EXPECT_EQ(((uintptr_t)column.row(1, 2)) % AoSoA::RowSize, 0u);
+    EXPECT_EQ(column.row(1, 0)[3], 11.0f);
+    EXPECT_EQ(column.row(1, 2)[3], 33.0f);
+    EXPECT_EQ(column.load(20).y, 40.0f);
+    thrown = false;
+    try { arch->getComponentDataRO(chunk, 3, indexInTypeArray); }
+    catch(const std::invalid_argument&) { thrown = true; }
+    EXPECT_EQ(thrown, true);
+
+    // removal fills holes from the tail at unaligned indices
+    std::vector<Entity> destroyed = {entities[3], entities[4], entities[5]};
+    ecs->destroyEntities({destroyed.data(), (uint32_t)destroyed.size()});
+    entities.erase(entities.begin() + 3, entities.begin() + 6);
+    // conversion into another archetype keeps the values and clears new AoSoA columns
+    ecs->addComponent(entities[10], getTypeID<large_component>());
+    Entity fresh;
+    ecs->createEntities(ecs->getOrCreateArchetype(componentTypes<Entity,large_component>()), {&fresh, 1});
+    ecs->addComponent(fresh, getTypeID<aosoa_vector>());
+    aosoa_vector value;
+    ecs->getComponentData(fresh, getTypeID<aosoa_vector>(), &value);
+    EXPECT_EQ(value.x + value.y + value.z, 0.0f);
+    uint32_t mismatches = 0;
+    for(Entity entity:entities){
+        ecs->getComponentData(entity, getTypeID<aosoa_vector>(), &value);
+        if(value.y != 2 * value.x || value.z != 3 * value.x)
+            mismatches++;
+    }
+    EXPECT_EQ(mismatches, 0u);
+    ecs->getComponentData(entities[10], getTypeID<aosoa_vector>(), &value);
+    EXPECT_EQ(value.z, 39.0f);
+    ecs->destroyEntities({entities.data(), (uint32_t)entities.size()});
+    ecs->destroyEntities({&fresh, 1});
+}
+
+TEST(ColdStorage) {
+    using namespace ECS;
+    EXPECT_EQ(getTypeID<cold_component>().isCold(), true);
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    Archetype *hot = ecs->getOrCreateArchetype(componentTypes<Entity,odd_component,large_component>());
+    Archetype *split = ecs->getOrCreateArchetype(componentTypes<Entity,odd_component,cold_component>());
+    EXPECT_EQ(hot->hasColdComponents(), false);
+    EXPECT_EQ(split->hasColdComponents(), true);
+    // cold bytes do not dilute the hot chunk
+    EXPECT_GE(split->getChunkCapacity(1), 2 * hot->getChunkCapacity(1));
+    for(uint32_t c = 0;c < Chunk::SizeClassCount;c++)
+        EXPECT_NE(split->getColdSizeClass(c), (uint8_t)Chunk::SizeClassCount);
+
+    // MAGIC NUMBER, a few chunks worth of entities
+    std::vector<Entity> entities(300);
+    ecs->createEntities(split, {entities.data(), (uint32_t)entities.size()});
+    for(uint32_t i = 0; i < entities.size(); i++){
+        cold_component value = {};
+        value.data[0] = (uint8_t)i;
+        value.data[199] = (uint8_t)(i >> 8);
+        ecs->setComponentData(entities[i], getTypeID<cold_component>(), &value);
+    }
+    uint32_t outside = 0;
+    for(Chunk *chunk:split->getChunks()){
+        EXPECT_NE(chunk->companion, (Chunk*)nullptr);
+        const uint8_t *column = split->getComponentDataWithTypeRO(chunk, 0, getTypeID<cold_component>());
+        if(column < (const uint8_t*)chunk->companion || column >= (const uint8_t*)chunk->companion + chunk->companion->memorySize())
+            outside++;
+    }
+    EXPECT_EQ(outside, 0u);
+
+    // removal, conversion to a hot archetype and back keep both chunks in sync
+    std::vector<Entity> destroyed(entities.begin() + 10, entities.begin() + 50);
+    ecs->destroyEntities({destroyed.data(), (uint32_t)destroyed.size()});
+    entities.erase(entities.begin() + 10, entities.begin() + 50);
+    ecs->addComponent(entities[100], getTypeID<large_component>());
+    ecs->removeComponent(entities[101], getTypeID<cold_component>());
+    ecs->addComponent(entities[101], getTypeID<cold_component>());
+    uint32_t mismatches = 0;
+    for(uint32_t i = 0; i < entities.size(); i++){
+        if(i == 101)
+            continue;
+        cold_component value;
+        ecs->getComponentData(entities[i], getTypeID<cold_component>(), &value);
+        const uint32_t original = i < 10 ? i : i + 40;
+        if(value.data[0] != (uint8_t)original || value.data[199] != (uint8_t)(original >> 8))
+            mismatches++;
+    }
+    EXPECT_EQ(mismatches, 0u);
+    cold_component cleared;
+    ecs->getComponentData(entities[101], getTypeID<cold_component>(), &cleared);
+    EXPECT_EQ(cleared.data[0], 0u);
+    ecs->destroyEntities({entities.data(), (uint32_t)entities.size()});
+    EXPECT_EQ(split->getChunks().size(), 0u);
+}
+
+CLASS_TEST(Test,ArchetypeTransitions) {
+    using namespace ECS;
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    Archetype *base = ecs->getOrCreateArchetype(componentTypes<Entity,large_component>());
+    Entity entity;
+    ecs->createEntities(base, {&entity, 1});
+    ((large_component*)ecs->getComponentDataWithTypeRW(entity, getTypeID<large_component>()))->data[7] = 7;
+    // MAGIC NUMBER, toggles of the same tag
+    for(uint32_t i = 0; i < 4; i++){
+        EXPECT_EQ(ecs->addComponent(entity, getTypeID<transition_tag>()), true);
+        EXPECT_EQ(ecs->removeComponent(entity, getTypeID<transition_tag>()), true);
+    }
+    EXPECT_EQ(ecs->removeComponent(entity, getTypeID<odd_component>()), false);
+    EXPECT_EQ(ecs->removeComponent(entity, getTypeID<odd_component>()), false);
+    Archetype *tagged = ecs->getArchetypeWithAddedComponent(base, getTypeID<transition_tag>());
+    EXPECT_NE(tagged, (Archetype*)nullptr);
+    // every transition was resolved once, later ones hit the edges and reuse the conversion plans
+    EXPECT_EQ(base->addEdges.size(), 1u);
+    EXPECT_EQ(base->removeEdges.size(), 1u);
+    EXPECT_EQ(tagged->removeEdges.size(), 1u);
+    EXPECT_EQ(base->conversions.size(), 1u);
+    EXPECT_EQ(tagged->conversions.size(), 1u);
+    EXPECT_EQ(base->conversionColumns.size(), (size_t)base->numNonZeroSizedTypes());
+    uint32_t index = 0;
+    EXPECT_EQ(ecs->getArchetypeWithRemovedComponent(tagged, getTypeID<transition_tag>(), &index), base);
+    EXPECT_EQ(tagged->getTypes()[index] == getTypeID<transition_tag>(), true);
+    EXPECT_EQ(((const large_component*)ecs->getComponentDataWithTypeRO(entity, getTypeID<large_component>()))->data[7], 7u);
+    ecs->destroyEntities({&entity, 1});
+}
+
+TEST(QueryStructuralChange) {
+    using namespace ECS;
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    std::unique_ptr<EntityQueryManager> eqm = std::make_unique<EntityQueryManager>(ecs.get());
+    Archetype *base = ecs->getOrCreateArchetype(componentTypes<Entity,large_component>());
+    // MAGIC NUMBER, a few chunks
+    std::vector<Entity> entities(500);
+    ecs->createEntities(base, {entities.data(), (uint32_t)entities.size()});
+    for(uint32_t i = 0; i < entities.size(); i++)
+        ((large_component*)ecs->getComponentDataWithTypeRW(entities[i], getTypeID<large_component>()))->data[0] = (uint8_t)i;
+    EntityQueryBuilder builder;
+    builder.withAll(getTypeID<large_component>());
+    EntityQueryImpl query = eqm->createEntityQuery(builder);
+
+    std::vector<Chunk*> before(base->getChunks().begin(), base->getChunks().end());
+    EXPECT_EQ(eqm->addComponent(query, getTypeID<transition_tag>()), 500u);
+    EXPECT_EQ(base->count(), 0u);
+    // a tag keeps the layout, chunks are retagged in place
+    Archetype *tagged = ecs->getOrCreateArchetype(componentTypes<Entity,large_component,transition_tag>());
+    std::vector<Chunk*> after(tagged->getChunks().begin(), tagged->getChunks().end());
+    std::sort(before.begin(), before.end());
+    std::sort(after.begin(), after.end());
+    EXPECT_EQ(before == after, true);
+    EXPECT_EQ(eqm->addComponent(query, getTypeID<transition_tag>()), 0u);
+    EXPECT_EQ(eqm->removeComponent(query, getTypeID<transition_tag>()), 500u);
+    EXPECT_EQ(tagged->count(), 0u);
+    EXPECT_EQ(base->count(), 500u);
+    // data columns change, entities are copied chunk by chunk
+    EXPECT_EQ(eqm->addComponent(query, getTypeID<odd_component>()), 500u);
+    EXPECT_EQ(base->count(), 0u);
+    uint32_t mismatches = 0;
+    for(uint32_t i = 0; i < entities.size(); i++)
+        if(((const large_component*)ecs->getComponentDataWithTypeRO(entities[i], getTypeID<large_component>()))->data[0] != (uint8_t)i)
+            mismatches++;
+    EXPECT_EQ(mismatches, 0u);
+    ecs->destroyEntities({entities.data(), (uint32_t)entities.size()});
+}
+
+TEST(DestroyWholeChunks) {
+    using namespace ECS;
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    Archetype *arch = ecs->getOrCreateArchetype(componentTypes<Entity,large_component>());
+    // MAGIC NUMBER, a few chunks
+    std::vector<Entity> entities(2000);
+    ecs->createEntities(arch, {entities.data(), (uint32_t)entities.size()});
+    const uint32_t chunkCount = arch->getChunks().size();
+    EXPECT_GE(chunkCount, 3u);
+    // a partial batch first, the chunk keeps its remaining entities
+    ecs->destroyEntities({entities.data(), 10});
+    EXPECT_EQ(arch->count(), 1990u);
+    EXPECT_EQ(arch->getChunks().size(), chunkCount);
+    // stale entities are skipped by both paths
+    ecs->destroyEntities({entities.data(), 10});
+    EXPECT_EQ(arch->count(), 1990u);
+    // the first chunk is now out of order, the following ones are destroyed whole
+    ecs->destroyEntities({entities.data() + 10, (uint32_t)entities.size() - 10});
+    EXPECT_EQ(arch->count(), 0u);
+    EXPECT_EQ(arch->getChunks().size(), 0u);
+    uint32_t alive = 0;
+    for(Entity entity:entities)
+        alive += ecs->exists(entity) ? 1 : 0;
+    EXPECT_EQ(alive, 0u);
+    // the freed slots are reusable
+    ecs->createEntities(arch, {entities.data(), (uint32_t)entities.size()});
+    EXPECT_EQ(arch->count(), 2000u);
+    ecs->destroyEntities({entities.data(), (uint32_t)entities.size()});
+    EXPECT_EQ(arch->count(), 0u);
+}
+
+CLASS_TEST(Test,ArchetypeMetadata) {
+    using namespace ECS;
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    std::unique_ptr<EntityQueryManager> eqm = std::make_unique<EntityQueryManager>(ecs.get());
+    // per archetype query bookkeeping no longer scales with Constants::MaximumQueryCount
+    EXPECT_EQ(sizeof(Archetype) < 1024, true);
+    EntityQueryBuilder builder0;
+    builder0.withAll(getTypeID<combo_component<0>>());
+    EntityQueryImpl query0 = eqm->createEntityQuery(builder0);
+    EntityQueryBuilder builder1;
+    builder1.withAll(getTypeID<combo_component<1>>());
+    EntityQueryImpl query1 = eqm->createEntityQuery(builder1);
+    const TypeID combo[10] = {
+        getTypeID<combo_component<0>>(), getTypeID<combo_component<1>>(), getTypeID<combo_component<2>>(),
+        getTypeID<combo_component<3>>(), getTypeID<combo_component<4>>(), getTypeID<combo_component<5>>(),
+        getTypeID<combo_component<6>>(), getTypeID<combo_component<7>>(), getTypeID<combo_component<8>>(),
+        getTypeID<combo_component<9>>(),
+    };
+    // every non empty combination, 1023 archetypes
+    std::vector<Archetype*> archetypes;
+    for(uint32_t mask = 1; mask < (1u << 10); mask++){
+        Archetype *arch = ecs->getOrCreateArchetype(componentTypes<Entity>());
+        for(uint32_t bit = 0; bit < 10; bit++)
+            if(mask & (1u << bit))
+                arch = ecs->getArchetypeWithAddedComponent(arch, combo[bit]);
+        archetypes.push_back(arch);
+    }
+    // a query created after the archetypes
+    EntityQueryBuilder builder2;
+    builder2.withAll(getTypeID<combo_component<2>>());
+    EntityQueryImpl query2 = eqm->createEntityQuery(builder2);
+    eqm->updateNewArchetypes();
+    uint32_t matching = 0;
+    for(Archetype *arch:archetypes)
+        matching += (uint32_t)std::count(arch->matchingQueryData.begin(), arch->matchingQueryData.end(), query0.getData());
+    EXPECT_EQ(matching, 512u);
+    uint32_t mismatches = 0;
+    for(uint32_t i = 0; i < archetypes.size(); i++){
+        const uint32_t mask = i + 1;
+        const uint32_t expected = (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1);
+        if(archetypes[i]->matchingQueryData.size() != expected)
+            mismatches++;
+    }
+    EXPECT_EQ(mismatches, 0u);
+    // matching twice does not register a query twice
+    eqm->addAdditionalArchetypes({archetypes.data(), (uint32_t)archetypes.size()});
+    EXPECT_EQ(archetypes[0]->matchingQueryData.size(), 1u);
+    EXPECT_EQ(archetypes[2]->matchingQueryData.size(), 2u);
+    // only one of the empty slot trackers is allocated
+    EXPECT_EQ(archetypes[0]->freeChunksBySharedComponents.capacity(), 0u);
+    EXPECT_EQ(std::count(archetypes[2]->matchingQueryData.begin(), archetypes[2]->matchingQueryData.end(), query1.getData()), 1);
+    (void)query2;
+}
+
+struct CountJob : ECS::IJobChunk {
+    uint32_t chunks = 0;
+    uint32_t entities = 0;
+    void execute(const ECS::Chunk *ch, const_span<int32_t>){
+        chunks++;
+        entities += ch->count;
+    }
+};
+
+CLASS_TEST(Test,ArchetypeCollector) {
+    using namespace ECS;
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    std::unique_ptr<EntityQueryManager> eqm = std::make_unique<EntityQueryManager>(ecs.get());
+    Archetype *base = ecs->getOrCreateArchetype(componentTypes<Entity,large_component>());
+    std::vector<Entity> entities(300);
+    ecs->createEntities(base, {entities.data(), (uint32_t)entities.size()});
+    for(uint32_t i = 0; i < entities.size(); i++)
+        ((large_component*)ecs->getComponentDataWithTypeRW(entities[i], getTypeID<large_component>()))->data[0] = (uint8_t)i;
+    EntityQueryBuilder builder;
+    builder.withAll(getTypeID<large_component>());
+    EntityQueryImpl query = eqm->createEntityQuery(builder);
+    // disabled by default
+    EXPECT_EQ(ecs->collectEmptyArchetypes(), 0u);
+
+    // a transient combination, entities pass through it and come back
+    EXPECT_EQ(eqm->addComponent(query, getTypeID<odd_component>()), 300u);
+    EXPECT_EQ(eqm->removeComponent(query, getTypeID<odd_component>()), 300u);
+    const uint32_t archetypeCount = ecs->getArchetypes().size();
+    EXPECT_NE(ecs->getExistingArchetype(componentTypes<Entity,large_component,odd_component>()), nullptr);
+
+    ecs->setArchetypeRetireFrames(2);
+    EXPECT_EQ(ecs->collectEmptyArchetypes(), 0u);
+    EXPECT_EQ(ecs->collectEmptyArchetypes(), 1u);
+    EXPECT_EQ(ecs->getArchetypes().size(), archetypeCount - 1);
+    EXPECT_EQ(ecs->getExistingArchetype(componentTypes<Entity,large_component,odd_component>()), nullptr);
+    EXPECT_EQ(base->addEdges.size(), 0u);
+    EXPECT_EQ(base->conversions.size(), 0u);
+    EXPECT_EQ(base->matchingQueryData.size(), 1u);
+    // the query only sees the live archetype
+    JobChunkWrapper<CountJob> wrapper;
+    wrapper.run(query);
+    EXPECT_EQ(wrapper.jobData.entities, 300u);
+    EXPECT_EQ(wrapper.jobData.chunks, (uint32_t)base->getChunks().size());
+
+    // recreated on demand and picked up by the query again
+    EXPECT_EQ(eqm->addComponent(query, getTypeID<odd_component>()), 300u);
+    Archetype *recreated = ecs->getExistingArchetype(componentTypes<Entity,large_component,odd_component>());
+    EXPECT_NE(recreated, nullptr);
+    EXPECT_EQ(recreated->count(), 300u);
+    uint32_t mismatches = 0;
+    for(uint32_t i = 0; i < entities.size(); i++)
+        if(((const large_component*)ecs->getComponentDataWithTypeRO(entities[i], getTypeID<large_component>()))->data[0] != (uint8_t)i)
+            mismatches++;
+    EXPECT_EQ(mismatches, 0u);
+    // base is empty now, a non empty archetype resets its counter
+    EXPECT_EQ(ecs->collectEmptyArchetypes(), 0u);
+    EXPECT_EQ(eqm->removeComponent(query, getTypeID<odd_component>()), 300u);
+    EXPECT_EQ(ecs->collectEmptyArchetypes(), 0u);
+    EXPECT_EQ(ecs->collectEmptyArchetypes(), 1u);
+    ecs->destroyEntities({entities.data(), (uint32_t)entities.size()});
+}
+
+TEST(CreateWithColumns) {
+    using namespace ECS;
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    Archetype *arch = ecs->getOrCreateArchetype(componentTypes<Entity,aosoa_vector,large_component,odd_component,cold_component>());
+    // MAGIC NUMBER, several chunks
+    const uint32_t count = 1000;
+    std::vector<aosoa_vector> vectors(count);
+    std::vector<large_component> larges(count);
+    std::vector<cold_component> colds(count);
+    for(uint32_t i = 0; i < count; i++){
+        vectors[i].x = (float)i; vectors[i].y = (float)i * 2; vectors[i].z = -(float)i;
+        larges[i].data[0] = (uint8_t)i; larges[i].data[199] = (uint8_t)(i >> 8);
+        colds[i].data[7] = (uint8_t)(i * 3);
+    }
+    const ComponentColumn columns[] = {
+        {getTypeID<large_component>(), larges.data()},
+        {getTypeID<aosoa_vector>(), vectors.data()},
+        {getTypeID<cold_component>(), colds.data()},
+    };
+    std::vector<Entity> entities(count);
+    ecs->createEntities(arch, {entities.data(), count}, {columns, 3});
+    EXPECT_EQ(arch->count(), count);
+    uint32_t mismatches = 0;
+    for(uint32_t i = 0; i < count; i++){
+        aosoa_vector vector;
+        ecs->getComponentData(entities[i], getTypeID<aosoa_vector>(), &vector);
+        const large_component *large = (const large_component*)ecs->getComponentDataWithTypeRO(entities[i], getTypeID<large_component>());
+        const cold_component *cold = (const cold_component*)ecs->getComponentDataWithTypeRO(entities[i], getTypeID<cold_component>());
+        const odd_component *odd = (const odd_component*)ecs->getComponentDataWithTypeRO(entities[i], getTypeID<odd_component>());
+        if(vector.x != (float)i || vector.y != (float)i * 2 || vector.z != -(float)i)
+            mismatches++;
+        if(large->data[0] != (uint8_t)i || large->data[199] != (uint8_t)(i >> 8) || cold->data[7] != (uint8_t)(i * 3))
+            mismatches++;
+        // columns not listed are default initialized
+        if(odd->data[0] != 0 || odd->data[2] != 0)
+            mismatches++;
+    }
+    EXPECT_EQ(mismatches, 0u);
+    // invalid columns
+    const ComponentColumn missing[] = {{getTypeID<wide_component>(), larges.data()}};
+    bool thrown = false;
+    try { ecs->createEntities(arch, {entities.data(), 1}, {missing, 1}); } catch(const std::invalid_argument&) { thrown = true; }
+    EXPECT_EQ(thrown, true);
+    const ComponentColumn repeated[] = {columns[0], columns[0]};
+    thrown = false;
+    try { ecs->createEntities(arch, {entities.data(), 1}, {repeated, 2}); } catch(const std::invalid_argument&) { thrown = true; }
+    EXPECT_EQ(thrown, true);
+    EXPECT_EQ(arch->count(), count);
+    ecs->destroyEntities({entities.data(), count});
+}
+
+TEST(Instantiate) {
+    using namespace ECS;
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    Archetype *arch = ecs->getOrCreateArchetype(componentTypes<Entity,aosoa_vector,large_component,odd_component,cold_component>());
+    Entity prefab;
+    ecs->createEntities(arch, {&prefab, 1});
+    const aosoa_vector vector = {{}, 1.5f, -2.0f, 3.0f};
+    ecs->setComponentData(prefab, getTypeID<aosoa_vector>(), &vector);
+    large_component *large = (large_component*)ecs->getComponentDataWithTypeRW(prefab, getTypeID<large_component>());
+    for(uint32_t i = 0; i < 200; i++)
+        large->data[i] = (uint8_t)(i + 1);
+    ((odd_component*)ecs->getComponentDataWithTypeRW(prefab, getTypeID<odd_component>()))->data[2] = 9;
+    ((cold_component*)ecs->getComponentDataWithTypeRW(prefab, getTypeID<cold_component>()))->data[100] = 42;
+
+    // MAGIC NUMBER, fills the prefab chunk and a few more, odd counts exercise partial doubling steps
+    const uint32_t count = 1001;
+    std::vector<Entity> clones(count);
+    ecs->instantiate(prefab, {clones.data(), count});
+    EXPECT_EQ(arch->count(), count + 1);
+    uint32_t mismatches = 0;
+    for(Entity clone:clones){
+        aosoa_vector value;
+        ecs->getComponentData(clone, getTypeID<aosoa_vector>(), &value);
+        if(value.x != 1.5f || value.y != -2.0f || value.z != 3.0f)
+            mismatches++;
+        if(memcmp(ecs->getComponentDataWithTypeRO(clone, getTypeID<large_component>()), large, sizeof(large_component)) != 0)
+            mismatches++;
+        if(((const odd_component*)ecs->getComponentDataWithTypeRO(clone, getTypeID<odd_component>()))->data[2] != 9)
+            mismatches++;
+        if(((const cold_component*)ecs->getComponentDataWithTypeRO(clone, getTypeID<cold_component>()))->data[100] != 42)
+            mismatches++;
+    }
+    EXPECT_EQ(mismatches, 0u);
+    // distinct entities
+    std::vector<Entity> sorted = clones;
+    sorted.push_back(prefab);
+    std::sort(sorted.begin(), sorted.end(), [](Entity a, Entity b){return a.index() < b.index();});
+    EXPECT_EQ(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end(), true);
+    ecs->destroyEntities({clones.data(), count});
+    EXPECT_EQ(arch->count(), 1u);
+    bool thrown = false;
+    try { ecs->instantiate(clones[0], {clones.data(), 1}); } catch(const std::invalid_argument&) { thrown = true; }
+    EXPECT_EQ(thrown, true);
+    ecs->destroyEntities({&prefab, 1});
+}
+
+TEST(DefaultPrototype) {
+    using namespace ECS;
+    EXPECT_NE(TypeManager::GetTypeInfo(getTypeID<default_component>()).Prototype, (const void*)nullptr);
+    // all zero defaults keep using memset
+    EXPECT_EQ(TypeManager::GetTypeInfo(getTypeID<odd_component>()).Prototype, (const void*)nullptr);
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    Archetype *arch = ecs->getOrCreateArchetype(componentTypes<Entity,default_component,default_vector,odd_component>());
+    // MAGIC NUMBER, several chunks with a partial last one
+    const uint32_t count = 1001;
+    std::vector<Entity> entities(count);
+    ecs->createEntities(arch, {entities.data(), count});
+    uint32_t mismatches = 0;
+    for(Entity entity:entities){
+        const default_component *component = (const default_component*)ecs->getComponentDataWithTypeRO(entity, getTypeID<default_component>());
+        default_vector vector;
+        ecs->getComponentData(entity, getTypeID<default_vector>(), &vector);
+        if(component->value != 2.5f || component->flags != 7 || vector.x != 1.0f || vector.y != 0.0f || vector.z != -1.0f)
+            mismatches++;
+        if(((const odd_component*)ecs->getComponentDataWithTypeRO(entity, getTypeID<odd_component>()))->data[1] != 0)
+            mismatches++;
+    }
+    EXPECT_EQ(mismatches, 0u);
+    // components added by a conversion start from the default too
+    Entity plain;
+    ecs->createEntities(ecs->getOrCreateArchetype(componentTypes<Entity,odd_component>()), {&plain, 1});
+    ecs->addComponent(plain, getTypeID<default_component>());
+    EXPECT_EQ(((const default_component*)ecs->getComponentDataWithTypeRO(plain, getTypeID<default_component>()))->flags, 7u);
+    ecs->destroyEntities({entities.data(), count});
+    ecs->destroyEntities({&plain, 1});
+}
+
+TEST(ManagedRelocation) {
+    using namespace ECS;
+    EXPECT_EQ(TypeManager::GetTypeInfo(getTypeID<odd_component>()).IsTriviallyDestructible(), true);
+    EXPECT_EQ(TypeManager::GetTypeInfo(getTypeID<odd_component>()).IsTriviallyRelocatable(), true);
+    EXPECT_EQ(TypeManager::GetTypeInfo(getTypeID<tracked_component>()).IsTriviallyDestructible(), false);
+    EXPECT_EQ(TypeManager::GetTypeInfo(getTypeID<tracked_component>()).IsTriviallyRelocatable(), false);
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    Archetype *arch = ecs->getOrCreateArchetype(componentTypes<Entity,odd_component,tracked_component>());
+    // MAGIC NUMBER, several chunks
+    const uint32_t count = 500;
+    std::vector<Entity> entities(count);
+    ecs->createEntities(arch, {entities.data(), count});
+    EXPECT_EQ(tracked_component::live, (int32_t)count);
+    for(uint32_t i = 0; i < count; i++)
+        ((tracked_component*)ecs->getComponentDataWithTypeRW(entities[i], getTypeID<tracked_component>()))->value = i;
+    // holes are filled from the tail, moving components within the chunk
+    std::vector<Entity> destroyed(entities.begin() + 10, entities.begin() + 20);
+    ecs->destroyEntities({destroyed.data(), (uint32_t)destroyed.size()});
+    EXPECT_EQ(tracked_component::live, (int32_t)count - 10);
+    // conversions move the managed column into the new chunk
+    for(uint32_t i = 20; i < 60; i++)
+        ecs->addComponent(entities[i], getTypeID<large_component>());
+    // and destroy the dropped one
+    for(uint32_t i = 60; i < 80; i++)
+        ecs->removeComponent(entities[i], getTypeID<tracked_component>());
+    EXPECT_EQ(tracked_component::live, (int32_t)count - 30);
+    uint32_t mismatches = 0;
+    for(uint32_t i = 20; i < count; i++){
+        if(i >= 60 && i < 80)
+            continue;
+        const tracked_component *tracked = (const tracked_component*)ecs->getComponentDataWithTypeRO(entities[i], getTypeID<tracked_component>());
+        if(tracked->self != tracked || tracked->value != i)
+            mismatches++;
+    }
+    EXPECT_EQ(mismatches, 0u);
+    entities.erase(entities.begin() + 10, entities.begin() + 20);
+    ecs->destroyEntities({entities.data(), (uint32_t)entities.size()});
+    EXPECT_EQ(tracked_component::live, 0);
+}
+
+TEST(EntityAllocation) {
+    using namespace ECS;
+    std::unique_ptr<EntityStore> store = std::make_unique<EntityStore>();
+    // MAGIC NUMBER, spans a few data blocks
+    const uint32_t count = 20000;
+    std::vector<Entity> entities(count);
+    store->allocateEntities({entities.data(), count});
+    uint32_t mismatches = 0;
+    for(uint32_t i = 0; i < count; i++)
+        if(entities[i].index() != (int32_t)i)
+            mismatches++;
+    EXPECT_EQ(mismatches, 0u);
+    // scattered holes in the first block and a whole word in the second one
+    std::vector<Entity> freed;
+    for(uint32_t i = 3; i < 8000; i += 37)
+        freed.push_back(entities[i]);
+    for(uint32_t i = 8192 + 64; i < 8192 + 96; i++)
+        freed.push_back(entities[i]);
+    store->deallocateEntities({freed.data(), (uint32_t)freed.size()});
+    std::vector<Entity> reused(freed.size() + 10);
+    store->allocateEntities({reused.data(), (uint32_t)reused.size()});
+    for(uint32_t i = 0; i < freed.size(); i++)
+        if(reused[i].index() != freed[i].index() || reused[i].version() == freed[i].version())
+            mismatches++;
+    for(uint32_t i = 0; i < 10; i++)
+        if(reused[freed.size() + i].index() != (int32_t)(count + i))
+            mismatches++;
+    EXPECT_EQ(mismatches, 0u);
+    store->integrityCheck();
+}
+
+TEST(ReserveEntities) {
+    using namespace ECS;
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    Archetype *arch = ecs->getOrCreateArchetype(componentTypes<Entity,default_component>());
+    Entity existing;
+    ecs->createEntities(arch, {&existing, 1});
+    // the cache takes a run of ids and hands out the last one, the one before it is still idle in the cache
+    Entity single;
+    ecs->reserveEntities({&single, 1});
+    const Entity idle{single.index() - 1, single.version()};
+    bool idleThrown = false;
+    try { ecs->createReservedEntities(arch, {&idle, 1}); } catch(const std::invalid_argument&) { idleThrown = true; }
+    EXPECT_EQ(idleThrown, true);
+    // flushed ids go back to the blocks, a batch too large for the cache takes them again
+    ecs->flushReservations();
+    std::vector<Entity> again(64);
+    ecs->reserveEntities({again.data(), (uint32_t)again.size()});
+    EXPECT_EQ(again[0].index() < single.index(), true);
+    // MAGIC NUMBER, a few workers reserving small and large batches at once
+    const uint32_t threadCount = 4, perThread = 3000;
+    std::vector<Entity> reserved(threadCount * perThread);
+    std::vector<std::thread> threads;
+    for(uint32_t t = 0; t < threadCount; t++)
+        threads.emplace_back([&ecs, &reserved, t](){
+            Entity *out = reserved.data() + t * perThread;
+            for(uint32_t i = 0; i < perThread;){
+                const uint32_t batch = std::min(perThread - i, (i % 7 == 0) ? 100u : 1u + i % 5);
+                ecs->reserveEntities({out + i, batch});
+                i += batch;
+            }
+        });
+    for(std::thread &thread:threads)
+        thread.join();
+    reserved.push_back(single);
+    reserved.insert(reserved.end(), again.begin(), again.end());
+    std::vector<Entity> sorted = reserved;
+    sorted.push_back(existing);
+    std::sort(sorted.begin(), sorted.end(), [](Entity a, Entity b){return a.index() < b.index();});
+    EXPECT_EQ(std::adjacent_find(sorted.begin(), sorted.end(), [](Entity a, Entity b){return a.index() == b.index();}) == sorted.end(), true);
+    EXPECT_EQ(ecs->exists(reserved[0]), false);
+    // repeated and already created entities are rejected before anything is created
+    Entity invalid[] = {reserved[0], reserved[0]};
+    bool thrown = false;
+    try { ecs->createReservedEntities(arch, {invalid, 2}); } catch(const std::invalid_argument&) { thrown = true; }
+    EXPECT_EQ(thrown, true);
+    invalid[1] = existing;
+    thrown = false;
+    try { ecs->createReservedEntities(arch, {invalid, 2}); } catch(const std::invalid_argument&) { thrown = true; }
+    EXPECT_EQ(thrown, true);
+    EXPECT_EQ(arch->count(), 1u);
+
+    ecs->createReservedEntities(arch, {reserved.data(), (uint32_t)reserved.size()});
+    EXPECT_EQ(arch->count(), (uint32_t)reserved.size() + 1);
+    uint32_t mismatches = 0;
+    for(Entity entity:reserved)
+        if(!ecs->exists(entity) || ((const default_component*)ecs->getComponentDataWithTypeRO(entity, getTypeID<default_component>()))->flags != 7)
+            mismatches++;
+    EXPECT_EQ(mismatches, 0u);
+    ecs->destroyEntities({reserved.data(), (uint32_t)reserved.size()});
+    ecs->destroyEntities({&existing, 1});
+    EXPECT_EQ(arch->count(), 0u);
+}
+
+TEST(EntityNames) {
+    using namespace ECS;
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    Archetype *arch = ecs->getOrCreateArchetype(componentTypes<Entity,odd_component>());
+    // MAGIC NUMBER, spans two data blocks
+    const uint32_t count = 9000;
+    std::vector<Entity> entities(count);
+    ecs->createEntities(arch, {entities.data(), count});
+    EXPECT_EQ(memcmp(ecs->getName(entities[5]), EntityName::Null(), sizeof(EntityName)), 0);
+    EntityName first = {};
+    snprintf((char*)first.value, sizeof(first.value), "entity %u", 0u);
+    ecs->setName(entities[0], &first);
+    // naming thousands of other entities grows the table, the pointer must not move
+    const EntityName *firstName = ecs->getName(entities[0]);
+    for(uint32_t i = 0; i < count; i += 3){
+        EntityName name = {};
+        snprintf((char*)name.value, sizeof(name.value), "entity %u", i);
+        ecs->setName(entities[i], &name);
+    }
+    uint32_t mismatches = 0;
+    for(uint32_t i = 0; i < count; i++){
+        char expected[16] = {};
+        if(i % 3 == 0)
+            snprintf(expected, sizeof(expected), "entity %u", i);
+        if(memcmp(ecs->getName(entities[i])->value, expected, sizeof(expected)) != 0)
+            mismatches++;
+    }
+    EXPECT_EQ(mismatches, 0u);
+    for(uint32_t i = 0; i < count; i += 3){
+        EntityName name = {};
+        snprintf((char*)name.value, sizeof(name.value), "entity %u", i);
+        if(ecs->findEntityByName(name) != entities[i])
+            mismatches++;
+    }
+    EXPECT_EQ(mismatches, 0u);
+    EntityName missing = {};
+    snprintf((char*)missing.value, sizeof(missing.value), "entity %u", 1u);
+    EXPECT_EQ(ecs->findEntityByName(missing).isValid(), false);
+    // renaming, unnaming and destruction drop the old name
+    const EntityName renamed = {{'r', 'e', 'n', 'a', 'm', 'e', 'd'}};
+    ecs->setName(entities[3], &renamed);
+    EXPECT_EQ(memcmp(ecs->getName(entities[3]), &renamed, sizeof(EntityName)), 0);
+    EXPECT_EQ(ecs->getName(entities[0]) == firstName, true);
+    EXPECT_EQ(memcmp(firstName, &first, sizeof(EntityName)), 0);
+    EXPECT_EQ(ecs->findEntityByName(renamed) == entities[3], true);
+    EntityName oldName = {};
+    snprintf((char*)oldName.value, sizeof(oldName.value), "entity %u", 3u);
+    EXPECT_EQ(ecs->findEntityByName(oldName).isValid(), false);
+    ecs->setName(entities[6], nullptr);
+    EXPECT_EQ(memcmp(ecs->getName(entities[6]), EntityName::Null(), sizeof(EntityName)), 0);
+    // shared names stay findable until the last owner lets go
+    ecs->setName(entities[7], &renamed);
+    ecs->setName(entities[3], nullptr);
+    EXPECT_EQ(ecs->findEntityByName(renamed) == entities[7], true);
+    ecs->setName(entities[7], nullptr);
+    EXPECT_EQ(ecs->findEntityByName(renamed).isValid(), false);
+    snprintf((char*)oldName.value, sizeof(oldName.value), "entity %u", 0u);
+    EXPECT_EQ(ecs->findEntityByName(oldName) == entities[0], true);
+    ecs->destroyEntities({entities.data(), 1});
+    EXPECT_EQ(ecs->findEntityByName(oldName).isValid(), false);
+    Entity reused;
+    ecs->createEntities(arch, {&reused, 1});
+    EXPECT_EQ(reused.index(), entities[0].index());
+    EXPECT_EQ(memcmp(ecs->getName(reused), EntityName::Null(), sizeof(EntityName)), 0);
+    entities[0] = reused;
+    ecs->destroyEntities({entities.data(), count});
+}
+
+TEST(ConcurrentNamedDeallocation) {
+    using namespace ECS;
+    std::unique_ptr<EntityStore> store = std::make_unique<EntityStore>();
+    // MAGIC NUMBER, one data block per thread
+    const uint32_t threadCount = 4, perThread = 8192;
+    std::vector<Entity> entities(threadCount * perThread);
+    store->allocateEntities({entities.data(), (uint32_t)entities.size()});
+    for(uint32_t i = 0; i < entities.size(); i += 2){
+        EntityName name = {};
+        snprintf((char*)name.value, sizeof(name.value), "named %u", i);
+        store->setEntityName(entities[i], &name);
+    }
+    // every thread holds a different block while the shared name table shrinks
+    std::vector<std::thread> threads;
+    for(uint32_t t = 0; t < threadCount; t++)
+        threads.emplace_back([&store, &entities, t](){
+            for(uint32_t i = 0; i < perThread; i += 64)
+                store->deallocateEntities({entities.data() + t * perThread + i, 64});
+        });
+    for(std::thread &thread:threads)
+        thread.join();
+    uint32_t found = 0;
+    for(uint32_t i = 0; i < entities.size(); i += 2){
+        EntityName name = {};
+        snprintf((char*)name.value, sizeof(name.value), "named %u", i);
+        found += store->findEntityByName(name).isValid();
+    }
+    EXPECT_EQ(found, 0u);
+    store->integrityCheck();
+}
+
+int main(){mtest::run_all();return 0;}
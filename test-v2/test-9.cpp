@@ -0,0 +1,91 @@
+#include "ECS/EntityComponentStore.hpp"
+#include "ECS/EntityQueryManager.hpp"
+#include "ECS/JobChunk.hpp"
+#include "ECS/Archetype.hpp"
+#include "cutil/mini_test.hpp"
+#include <stdio.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+using namespace ECS;
+
+struct BenchPosition : IComponentData {
+    float x, y, z, w;
+};
+DEF_TYPE(BenchPosition)
+struct BenchVelocity : IComponentData {
+    float x, y, z, w;
+};
+DEF_TYPE(BenchVelocity)
+// cold data, spreads the queried columns over the chunk
+struct BenchPayload : IComponentData {
+    uint8_t data[96];
+};
+DEF_TYPE(BenchPayload)
+// one marker per archetype
+template<uint32_t N>
+struct BenchMarker : IComponentData {
+    uint8_t value;
+};
+DEF_TYPE(BenchMarker<0>)
+DEF_TYPE(BenchMarker<1>)
+DEF_TYPE(BenchMarker<2>)
+DEF_TYPE(BenchMarker<3>)
+
+struct IntegrateJob : IJobChunk {
+    float sum = 0;
+    void execute(const Chunk *ch, const_span<int32_t> index){
+        const Archetype *arch = ch->archetype;
+        const BenchVelocity *velocity = (const BenchVelocity*)arch->getComponentDataRO(ch, 0, index[0]);
+        const BenchPosition *position = (const BenchPosition*)arch->getComponentDataRO(ch, 0, index[1]);
+        for(uint32_t i = 0; i < ch->count; i++)
+            sum += position[i].x + velocity[i].x;
+    }
+};
+
+TEST(ChunkPrefetchBenchmark) {
+    std::unique_ptr<EntityComponentStore> ecs = std::make_unique<EntityComponentStore>();
+    std::unique_ptr<EntityQueryManager> eqm = std::make_unique<EntityQueryManager>(ecs.get());
+    Archetype *archs[4] = {
+        ecs->getOrCreateArchetype(componentTypes<Entity,BenchPosition,BenchVelocity,BenchPayload,BenchMarker<0>>()),
+        ecs->getOrCreateArchetype(componentTypes<Entity,BenchPosition,BenchVelocity,BenchPayload,BenchMarker<1>>()),
+        ecs->getOrCreateArchetype(componentTypes<Entity,BenchPosition,BenchVelocity,BenchPayload,BenchMarker<2>>()),
+        ecs->getOrCreateArchetype(componentTypes<Entity,BenchPosition,BenchVelocity,BenchPayload,BenchMarker<3>>()),
+    };
+    // MAGIC NUMBER, large enough to not fit into the last level cache
+    const uint32_t entityCount = 1 << 19;
+    std::vector<Entity> entities(entityCount);
+    // interleave chunk allocations, consecutive chunks of a query are then far apart in memory
+    const uint32_t step = 64;
+    for(uint32_t i = 0; i < entityCount; i += step)
+        ecs->createEntities(archs[(i / step) % 4], {entities.data() + i, step});
+    for(Entity entity:entities)
+        ((BenchPosition*)ecs->getComponentDataWithTypeRW(entity, getTypeID<BenchPosition>()))->x = 1;
+
+    EntityQueryBuilder builder;
+    builder.withAll(getTypeID<BenchVelocity>());
+    builder.withAll(getTypeID<BenchPosition>());
+    EntityQueryImpl query = eqm->createEntityQuery(builder);
+
+    JobChunkWrapper<IntegrateJob> wrapper;
+    const uint32_t defaultDistance = JobChunkWrapperBase::getPrefetchDistance();
+    const uint32_t distances[] = {0, 1, defaultDistance, 4};
+    // MAGIC NUMBER, passes per distance
+    const uint32_t repeat = 8;
+    for(uint32_t distance:distances){
+        JobChunkWrapperBase::setPrefetchDistance(distance);
+        wrapper.jobData.sum = 0;
+        const auto begin = std::chrono::steady_clock::now();
+        for(uint32_t r = 0; r < repeat; r++)
+            wrapper.run(query);
+        const auto end = std::chrono::steady_clock::now();
+        // the same data is visited whatever the distance
+        EXPECT_EQ(wrapper.jobData.sum, (float)(entityCount * repeat));
+        printf("prefetch distance %u: %.3f ms per pass\n", distance,
+            std::chrono::duration<double, std::milli>(end - begin).count() / repeat);
+    }
+    JobChunkWrapperBase::setPrefetchDistance(defaultDistance);
+    ecs->destroyEntities({entities.data(), entityCount});
+}
+
+int main(){mtest::run_all();return 0;}